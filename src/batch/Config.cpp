@@ -0,0 +1,112 @@
+#include "Config.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+static string trim(const string& s) {
+    size_t from = s.find_first_not_of(" \t\r");
+    if (from == string::npos) return "";
+    size_t to = s.find_last_not_of(" \t\r");
+    return s.substr(from, to - from + 1);
+}
+
+Config Config::load(const string& path) {
+    ifstream in(path);
+    if (!in) throw runtime_error("cannot open config " + path);
+    stringstream ss;
+    ss << in.rdbuf();
+    return parse(ss.str());
+}
+
+Config Config::parse(const string& text) {
+    Config config;
+    stringstream ss(text);
+    string line;
+    int number = 0;
+    while (getline(ss, line)) {
+        number++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        size_t eq = line.find('=');
+        if (eq == string::npos) {
+            throw runtime_error("config line " + to_string(number) + ": expected key = value");
+        }
+        string key = trim(line.substr(0, eq));
+        if (key.empty()) throw runtime_error("config line " + to_string(number) + ": empty key");
+        config.values[key] = trim(line.substr(eq + 1));
+    }
+    return config;
+}
+
+const string* Config::find(const string& key) const {
+    auto it = values.find(key);
+    if (it == values.end()) return nullptr;
+    used.insert(key);
+    return &it->second;
+}
+
+void Config::set(const string& key, const string& value) {
+    values[key] = value;
+}
+
+bool Config::has(const string& key) const {
+    return values.count(key) != 0;
+}
+
+string Config::getString(const string& key, const string& fallback) const {
+    const string* v = find(key);
+    return v ? *v : fallback;
+}
+
+double Config::getDouble(const string& key, double fallback) const {
+    const string* v = find(key);
+    if (!v) return fallback;
+    size_t end = 0;
+    double x = 0;
+    try { x = stod(*v, &end); } catch (const exception&) {}
+    if (end == 0 || end != v->size()) throw runtime_error("config: " + key + " is not a number");
+    return x;
+}
+
+int Config::getInt(const string& key, int fallback) const {
+    return static_cast<int>(getLong(key, fallback));
+}
+
+long long Config::getLong(const string& key, long long fallback) const {
+    const string* v = find(key);
+    if (!v) return fallback;
+    size_t end = 0;
+    long long x = 0;
+    try { x = stoll(*v, &end); } catch (const exception&) {}
+    if (end == 0 || end != v->size()) throw runtime_error("config: " + key + " is not an integer");
+    return x;
+}
+
+vector<string> Config::getList(const string& key) const {
+    vector<string> items;
+    const string* v = find(key);
+    if (!v) return items;
+
+    stringstream ss(*v);
+    string item;
+    while (getline(ss, item, ',')) {
+        item = trim(item);
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+vector<string> Config::getUnused() const {
+    vector<string> keys;
+    for (const auto& kv : values) {
+        if (!used.count(kv.first)) keys.push_back(kv.first);
+    }
+    return keys;
+}
+
+const map<string, string>& Config::getValues() const {
+    return values;
+}
@@ -0,0 +1,38 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Flat "key = value" run description. '#' starts a comment, blank lines are ignored,
+// and lists are comma separated. Every getter records the key as read, so typos
+// can be reported instead of silently falling back to defaults.
+class Config {
+private:
+    map<string, string> values;
+    mutable std::set<string> used;
+
+    const string* find(const string& key) const;
+
+public:
+    static Config load(const string& path);
+    static Config parse(const string& text);
+
+    void set(const string& key, const string& value);
+    bool has(const string& key) const;
+    string getString(const string& key, const string& fallback) const;
+    double getDouble(const string& key, double fallback) const;
+    int getInt(const string& key, int fallback) const;
+    long long getLong(const string& key, long long fallback) const;
+    vector<string> getList(const string& key) const;
+
+    // Keys present in the file that nothing has read yet
+    vector<string> getUnused() const;
+    const map<string, string>& getValues() const;
+};
+
+#endif //CONFIG_H
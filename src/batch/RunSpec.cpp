@@ -0,0 +1,261 @@
+#include "RunSpec.h"
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include "SinaiBilliard.h"
+#include "writer.h"
+
+using namespace std;
+
+static const char* SOLVERS[] = {"classical", "magnetic", "birkhoff", "occupation", "lyapunov", "escape", "gas", "quantum", "eigenstates"};
+
+RunSpec::RunSpec() : classical_points(MAX_POINTS), magnetic_points(MAX_POINTS) {}
+
+RunSpec RunSpec::fromConfig(const Config& config) {
+    RunSpec spec;
+    spec.a = config.getDouble("a", spec.a);
+    spec.b = config.getDouble("b", spec.b);
+    spec.l = config.getDouble("l", spec.l);
+    spec.h = config.getDouble("h", spec.h);
+    spec.edges = config.getString("edges", "");
+    spec.scatterers = config.getString("scatterers", "");
+
+    spec.initial = config.getString("initial", spec.initial);
+    spec.seed = static_cast<uint64_t>(config.getLong("seed", static_cast<long long>(spec.seed)));
+    if (spec.initial != "fan" && spec.initial != "interior" && spec.initial != "boundary") {
+        throw runtime_error("config: initial must be fan, interior or boundary");
+    }
+    spec.p0 = Vec2(config.getDouble("x0", 0), config.getDouble("y0", 0));
+    spec.angle = config.getDouble("angle", spec.angle);
+    spec.count = config.getInt("count", spec.count);
+    spec.threads = config.getInt("threads", spec.threads);
+
+    spec.solvers = config.getList("solvers");
+    if (spec.solvers.empty()) throw runtime_error("config: no solvers requested");
+    for (const string& solver : spec.solvers) {
+        bool known = false;
+        for (const char* s : SOLVERS) known = known || solver == s;
+        if (!known) throw runtime_error("config: unknown solver " + solver);
+    }
+
+    spec.classical_output = config.getString("classical.output", spec.classical_output);
+    spec.classical_points = config.getInt("classical.points", spec.classical_points);
+    spec.classical_resample_dt = config.getDouble("classical.resample_dt", spec.classical_resample_dt);
+    spec.classical_resample_samples = config.getInt("classical.resample_samples", spec.classical_resample_samples);
+    if (spec.classical_output != "raw" && spec.classical_output != "indexed") {
+        throw runtime_error("config: classical.output must be raw or indexed");
+    }
+    if (spec.classical_resample_dt > 0 && spec.classical_output != "indexed") {
+        throw runtime_error("config: classical.resample_dt needs classical.output = indexed");
+    }
+
+    spec.magnetic_field = config.getDouble("magnetic.field", spec.magnetic_field);
+    spec.magnetic_points = config.getInt("magnetic.points", spec.magnetic_points);
+
+    spec.birkhoff_bounces = config.getLong("birkhoff.bounces", spec.birkhoff_bounces);
+    spec.birkhoff_output = config.getString("birkhoff.output", spec.birkhoff_output);
+    spec.bins_s = config.getInt("birkhoff.bins_s", spec.bins_s);
+    spec.bins_p = config.getInt("birkhoff.bins_p", spec.bins_p);
+    if (spec.birkhoff_output != "histogram" && spec.birkhoff_output != "stream") {
+        throw runtime_error("config: birkhoff.output must be histogram or stream");
+    }
+
+    spec.occupation_bounces = config.getLong("occupation.bounces", spec.occupation_bounces);
+    spec.occupation_nx = config.getInt("occupation.nx", spec.occupation_nx);
+    spec.occupation_ny = config.getInt("occupation.ny", spec.occupation_ny);
+    spec.occupation_frames = config.getInt("occupation.frames", spec.occupation_frames);
+    if (spec.occupation_nx < 1 || spec.occupation_ny < 1) throw runtime_error("config: occupation grid must not be empty");
+
+    spec.lyapunov_bounces = config.getLong("lyapunov.bounces", spec.lyapunov_bounces);
+    spec.lyapunov_window = config.getInt("lyapunov.window", spec.lyapunov_window);
+
+    spec.escape_holes = config.getString("escape.holes", "");
+    spec.escape_bounces = config.getLong("escape.bounces", spec.escape_bounces);
+    spec.escape_bins = config.getInt("escape.bins", spec.escape_bins);
+
+    spec.gas_count = config.getInt("gas.count", spec.gas_count);
+    spec.gas_radius = config.getDouble("gas.radius", spec.gas_radius);
+    spec.gas_speed = config.getDouble("gas.speed", spec.gas_speed);
+    spec.gas_frames = config.getInt("gas.frames", spec.gas_frames);
+    spec.gas_dt = config.getDouble("gas.dt", spec.gas_dt);
+    spec.gas_seed = static_cast<uint64_t>(config.getLong("gas.seed", static_cast<long long>(spec.gas_seed)));
+    if (spec.gas_count < 1) throw runtime_error("config: gas.count must be positive");
+    if (spec.gas_radius <= 0) throw runtime_error("config: gas.radius must be positive");
+    if (spec.gas_frames < 0) throw runtime_error("config: gas.frames must not be negative");
+    if (spec.gas_dt <= 0) throw runtime_error("config: gas.dt must be positive");
+
+    spec.quantum_dh = config.getDouble("quantum.dh", spec.quantum_dh);
+    spec.quantum_dt = config.getDouble("quantum.dt", spec.quantum_dt);
+    spec.quantum_sigma = config.getDouble("quantum.sigma", spec.quantum_sigma);
+    spec.quantum_k = config.getDouble("quantum.k", spec.quantum_k);
+    spec.quantum_engine = config.getString("quantum.engine", spec.quantum_engine);
+    spec.quantum_states = config.getInt("quantum.states", spec.quantum_states);
+    spec.quantum_tolerance = config.getDouble("quantum.tolerance", spec.quantum_tolerance);
+    if (spec.quantum_engine != "rk4" && spec.quantum_engine != "split" && spec.quantum_engine != "spectral" &&
+        spec.quantum_engine != "chebyshev") {
+        throw runtime_error("config: quantum.engine must be rk4, split, spectral or chebyshev");
+    }
+    if (spec.quantum_engine == "spectral" && spec.quantum_states < 1) {
+        throw runtime_error("config: quantum.engine = spectral needs a positive quantum.states");
+    }
+    if (spec.quantum_tolerance <= 0) throw runtime_error("config: quantum.tolerance must be positive");
+
+    spec.eigenstates_count = config.getInt("eigenstates.count", spec.eigenstates_count);
+    spec.eigenstates_shift = config.getDouble("eigenstates.shift", spec.eigenstates_shift);
+    if (spec.eigenstates_count < 1) throw runtime_error("config: eigenstates.count must be positive");
+
+    // Geometry strings are parsed here so a malformed one fails before anything runs
+    if (!spec.edges.empty() && parseEdges(spec.edges).empty()) throw runtime_error("config: no edges in edges");
+    parseCircles(spec.scatterers);
+    bool escape = false;
+    for (const string& solver : spec.solvers) escape = escape || solver == "escape";
+    if (escape && parseHoles(spec.escape_holes).empty()) throw runtime_error("config: escape needs escape.holes");
+    return spec;
+}
+
+string RunSpec::canonical() const {
+    string out;
+    auto add = [&](const char* key, const string& value) {
+        out += key;
+        out += '=';
+        out += value;
+        out += '\n';
+    };
+    auto num = [](double x) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.17g", x);
+        return string(buf);
+    };
+
+    add("format", "1");
+    add("MAX_POINTS", to_string(MAX_POINTS));
+    add("WIDTH", to_string(WIDTH));
+    add("HEIGHT", to_string(HEIGHT));
+
+    if (edges.empty()) {
+        add("a", num(a));
+        add("b", num(b));
+        add("l", num(l));
+        add("h", num(h));
+    } else {
+        add("edges", edges);
+    }
+    add("scatterers", scatterers);
+    add("x0", num(p0.x));
+    add("y0", num(p0.y));
+    add("angle", num(angle));
+    // Left out for the fan, so results cached before sampling existed still match
+    if (initial != "fan") {
+        add("initial", initial);
+        add("seed", to_string(seed));
+    }
+    add("count", to_string(count));
+
+    // Only the parameters of requested solvers matter
+    for (const string& solver : solvers) {
+        add("solver", solver);
+        if (solver == "classical") {
+            add("classical.output", classical_output);
+            add("classical.points", to_string(classical_points));
+            if (classical_resample_dt > 0) {
+                add("classical.resample_dt", num(classical_resample_dt));
+                add("classical.resample_samples", to_string(classical_resample_samples));
+            }
+        } else if (solver == "magnetic") {
+            add("magnetic.field", num(magnetic_field));
+            add("magnetic.points", to_string(magnetic_points));
+        } else if (solver == "birkhoff") {
+            add("birkhoff.bounces", to_string(birkhoff_bounces));
+            add("birkhoff.output", birkhoff_output);
+            add("birkhoff.bins_s", to_string(bins_s));
+            add("birkhoff.bins_p", to_string(bins_p));
+        } else if (solver == "occupation") {
+            add("occupation.bounces", to_string(occupation_bounces));
+            add("occupation.nx", to_string(occupation_nx));
+            add("occupation.ny", to_string(occupation_ny));
+            add("occupation.frames", to_string(occupation_frames));
+        } else if (solver == "lyapunov") {
+            add("lyapunov.bounces", to_string(lyapunov_bounces));
+            add("lyapunov.window", to_string(lyapunov_window));
+        } else if (solver == "escape") {
+            add("escape.holes", escape_holes);
+            add("escape.bounces", to_string(escape_bounces));
+            add("escape.bins", to_string(escape_bins));
+        } else if (solver == "gas") {
+            add("gas.count", to_string(gas_count));
+            add("gas.radius", num(gas_radius));
+            add("gas.speed", num(gas_speed));
+            add("gas.frames", to_string(gas_frames));
+            add("gas.dt", num(gas_dt));
+            add("gas.seed", to_string(gas_seed));
+        } else if (solver == "quantum") {
+            add("quantum.dh", num(quantum_dh));
+            add("quantum.dt", num(quantum_dt));
+            add("quantum.sigma", num(quantum_sigma));
+            add("quantum.k", num(quantum_k));
+            // Left out for rk4, so results cached before the other engines existed still match
+            if (quantum_engine != "rk4") add("quantum.engine", quantum_engine);
+            if (quantum_engine == "spectral") add("quantum.states", to_string(quantum_states));
+            if (quantum_engine == "chebyshev") add("quantum.tolerance", num(quantum_tolerance));
+        } else if (solver == "eigenstates") {
+            add("quantum.dh", num(quantum_dh));
+            add("eigenstates.count", to_string(eigenstates_count));
+            add("eigenstates.shift", num(eigenstates_shift));
+        }
+    }
+    return out;
+}
+
+uint64_t RunSpec::hash() const {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : canonical()) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+void RunSpec::run() const {
+    SinaiBilliard billiard = edges.empty() ? SinaiBilliard(a, b, l, h) : SinaiBilliard(Billiard(parseEdges(edges)));
+    billiard.addScatterers(parseCircles(scatterers));
+    double theta = angle * M_PI / 180.0;
+    InitialConditions start = initial == "interior" ? InitialConditions::interior(seed)
+                            : initial == "boundary" ? InitialConditions::boundary(seed)
+                                                    : InitialConditions::fan(p0, theta);
+
+    for (const string& solver : solvers) {
+        if (solver == "classical") {
+            write_classical(billiard, start, count, threads,
+                            classical_output == "indexed" ? ClassicalOutput::INDEXED : ClassicalOutput::RAW,
+                            classical_points);
+            if (classical_resample_dt > 0) {
+                write_resampled(data_path("classical_data.traj", "../../data/"), classical_resample_dt,
+                                classical_resample_samples, threads);
+            }
+        } else if (solver == "magnetic") {
+            write_magnetic(billiard, magnetic_field, start, count, magnetic_points, threads);
+        } else if (solver == "birkhoff") {
+            write_birkhoff(billiard, start, count, birkhoff_bounces,
+                           birkhoff_output == "stream" ? BirkhoffOutput::STREAM : BirkhoffOutput::HISTOGRAM,
+                           bins_s, bins_p, threads);
+        } else if (solver == "occupation") {
+            write_occupation(billiard, start, count, occupation_bounces, occupation_nx, occupation_ny,
+                             occupation_frames, threads);
+        } else if (solver == "lyapunov") {
+            write_lyapunov(billiard, start, count, lyapunov_bounces, lyapunov_window, threads);
+        } else if (solver == "escape") {
+            write_escape(billiard, parseHoles(escape_holes), start, count, escape_bounces, escape_bins, threads);
+        } else if (solver == "gas") {
+            write_gas(billiard, gas_count, gas_radius, gas_speed, gas_frames, gas_dt, static_cast<unsigned>(gas_seed));
+        } else if (solver == "quantum") {
+            QuantumEngine engine = quantum_engine == "split"    ? QuantumEngine::SPLIT_OPERATOR
+                                 : quantum_engine == "spectral" ? QuantumEngine::SPECTRAL
+                                 : quantum_engine == "chebyshev" ? QuantumEngine::CHEBYSHEV
+                                                                : QuantumEngine::RK4;
+            write_quantum(quantum_dh, quantum_dt, quantum_sigma, p0.x, p0.y, quantum_k, theta, billiard, threads,
+                          engine, quantum_states, quantum_tolerance);
+        } else {
+            write_eigenstates(billiard, quantum_dh, eigenstates_count, eigenstates_shift);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef RUNSPEC_H
+#define RUNSPEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Config.h"
+#include "Vec2.h"
+
+using namespace std;
+
+// One fully resolved batch run: every parameter with its default filled in, so two
+// configs that differ only in spelled-out defaults describe (and hash to) the same run.
+struct RunSpec {
+    // Table: edges, when given, replace a, b, l, h
+    double a = 400, b = 500, l = 0, h = 0;
+    string edges, scatterers;
+
+    // Initial conditions: the fan from p0 at angle, or sampled from the seed
+    string initial = "fan"; // fan | interior | boundary
+    uint64_t seed = 1;
+    Vec2 p0;
+    double angle = 85;  // degrees
+    int count = 1;
+    int threads = 0;    // does not change any output, so it is not hashed
+
+    vector<string> solvers;
+
+    string classical_output = "raw";
+    int classical_points;
+    double classical_resample_dt = 0;  // 0 = no resampling onto a time grid
+    int classical_resample_samples = 1000;
+
+    double magnetic_field = 0.01;  // 1 / Larmor radius
+    int magnetic_points;
+
+    long long birkhoff_bounces = 1000000;
+    string birkhoff_output = "histogram";
+    int bins_s = 512, bins_p = 512;
+
+    long long occupation_bounces = 100000;
+    int occupation_nx = 256, occupation_ny = 256, occupation_frames = 1;
+
+    long long lyapunov_bounces = 100000;
+    int lyapunov_window = 1000;
+
+    string escape_holes;
+    long long escape_bounces = 100000;
+    int escape_bins = 200;
+
+    int gas_count = 100;            // disks asked for; fewer if the lattice runs out of room
+    double gas_radius = 5, gas_speed = 1, gas_dt = 1;
+    int gas_frames = 1000;
+    uint64_t gas_seed = 1;          // disk directions
+
+    double quantum_dh = 8, quantum_dt = 3, quantum_sigma = 10, quantum_k = 100;
+    string quantum_engine = "rk4"; // rk4 | split | spectral | chebyshev
+    int quantum_states = 0;         // spectral engine only, and required there
+    double quantum_tolerance = 1e-12; // chebyshev engine only
+
+    int eigenstates_count = 50;
+    double eigenstates_shift = 0;   // energies nearest this, 0 = the lowest states
+
+    RunSpec();
+
+    // Reads and validates every key; throws runtime_error on bad values
+    static RunSpec fromConfig(const Config& config);
+
+    // Every input that affects the outputs, one "key=value" per line, including the
+    // compiled-in MAX_POINTS, WIDTH and HEIGHT
+    string canonical() const;
+    uint64_t hash() const; // 64-bit FNV-1a of canonical()
+
+    // Runs the solvers in order; files go to the calling thread's data directory
+    void run() const;
+};
+
+#endif //RUNSPEC_H
@@ -0,0 +1,179 @@
+#include "Sweep.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "ThreadPool.h"
+#include "writer.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const string SWEEP_PREFIX = "sweep.";
+
+static string trim(const string& s) {
+    size_t from = s.find_first_not_of(" \t");
+    if (from == string::npos) return "";
+    size_t to = s.find_last_not_of(" \t");
+    return s.substr(from, to - from + 1);
+}
+
+static string hex(uint64_t h) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return buf;
+}
+
+// --- Sweep ---
+
+Sweep::Sweep(const Config& config) {
+    for (const auto& kv : config.getValues()) {
+        const string& key = kv.first;
+        if (key == "cache" || key == "workers") continue;
+        if (key.compare(0, SWEEP_PREFIX.size(), SWEEP_PREFIX) != 0) {
+            base.set(key, kv.second);
+            continue;
+        }
+
+        vector<string> values;
+        stringstream ss(kv.second);
+        string v;
+        while (getline(ss, v, '|')) {
+            values.push_back(trim(v));
+        }
+        if (values.empty()) throw runtime_error("config: " + key + " has no values");
+        axes.emplace_back(key.substr(SWEEP_PREFIX.size()), values);
+    }
+}
+
+int Sweep::size() const {
+    int n = 1;
+    for (const auto& axis : axes) n *= static_cast<int>(axis.second.size());
+    return n;
+}
+
+Config Sweep::point(int i) const {
+    Config config = base;
+    for (int k = static_cast<int>(axes.size()) - 1; k >= 0; k--) {
+        int n = static_cast<int>(axes[k].second.size());
+        config.set(axes[k].first, axes[k].second[i % n]);
+        i /= n;
+    }
+    return config;
+}
+
+string Sweep::describe(int i) const {
+    Config config = point(i);
+    string out;
+    for (const auto& axis : axes) {
+        if (!out.empty()) out += ' ';
+        out += axis.first + "=" + config.getString(axis.first, "");
+    }
+    return out;
+}
+
+// --- ResultCache ---
+
+ResultCache::ResultCache(const string& dir) : dir(dir) {}
+
+string ResultCache::path(const RunSpec& spec) const {
+    return (fs::path(dir) / hex(spec.hash())).string();
+}
+
+bool ResultCache::contains(const RunSpec& spec) const {
+    ifstream in(fs::path(path(spec)) / "spec.txt");
+    if (!in) return false;
+    stringstream ss;
+    ss << in.rdbuf();
+    return ss.str() == spec.canonical();
+}
+
+void ResultCache::store(const RunSpec& spec) const {
+    fs::path final_path = path(spec);
+    stringstream id;
+    id << this_thread::get_id();
+    fs::path scratch = final_path.string() + ".tmp." + id.str();
+    fs::remove_all(scratch);
+    fs::create_directories(scratch);
+
+    try {
+        set_data_directory(scratch.string());
+        spec.run();
+        set_data_directory("");
+        ofstream(scratch / "spec.txt") << spec.canonical();
+    } catch (...) {
+        set_data_directory("");
+        fs::remove_all(scratch);
+        throw;
+    }
+
+    // Loses the race gracefully if another sweep finished the same run first
+    error_code ec;
+    fs::rename(scratch, final_path, ec);
+    if (ec) fs::remove_all(scratch);
+}
+
+// --- Scheduler ---
+
+int runSweep(const Config& config) {
+    Sweep sweep(config);
+    int workers = config.getInt("workers", 0);
+    ThreadPool pool(workers);
+    bool cached = config.has("cache") || sweep.size() > 1;
+    ResultCache cache(config.getString("cache", "../../data/cache"));
+
+    // Resolve and validate every point before running any of them
+    vector<RunSpec> specs;
+    for (int i = 0; i < sweep.size(); i++) {
+        Config point = sweep.point(i);
+        // Points already run side by side; one thread each unless the config says otherwise
+        if (pool.size() > 1 && sweep.size() > 1 && !point.has("threads")) point.set("threads", "1");
+        specs.push_back(RunSpec::fromConfig(point));
+        if (i == 0) {
+            for (const string& key : point.getUnused()) {
+                cerr << "billiards_batch: warning: unknown key " << key << "\n";
+            }
+        }
+    }
+
+    // Repeated points in one sweep run once
+    map<uint64_t, int> first;
+    vector<int> todo;
+    for (int i = 0; i < sweep.size(); i++) {
+        if (first.emplace(specs[i].hash(), i).second) todo.push_back(i);
+    }
+
+    vector<string> status(sweep.size());
+    pool.parallel_for(static_cast<int>(todo.size()), 1, [&](int begin, int end, int) {
+        for (int k = begin; k < end; k++) {
+            int i = todo[k];
+            try {
+                if (!cached) {
+                    specs[i].run();
+                    status[i] = "ran";
+                } else if (cache.contains(specs[i])) {
+                    status[i] = "cached";
+                } else {
+                    cache.store(specs[i]);
+                    status[i] = "ran";
+                }
+            } catch (const exception& e) {
+                status[i] = string("failed: ") + e.what();
+            }
+        }
+    });
+
+    int failed = 0;
+    for (int i = 0; i < sweep.size(); i++) {
+        const string& s = status[first[specs[i].hash()]];
+        bool ok = s == "ran" || s == "cached";
+        failed += ok ? 0 : 1;
+        cout << hex(specs[i].hash()) << '\t' << (first[specs[i].hash()] == i ? s : "duplicate")
+             << '\t' << sweep.describe(i) << '\n';
+    }
+    return failed;
+}
@@ -0,0 +1,50 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "Config.h"
+#include "RunSpec.h"
+
+using namespace std;
+
+// Cartesian product of "sweep.<key> = v1 | v2 | ..." axes over a base config. Values are
+// separated by '|' because scatterer and edge lists contain commas. Without any sweep
+// keys the sweep is the base config alone.
+class Sweep {
+private:
+    Config base;                                 // config with the sweep and scheduler keys removed
+    vector<pair<string, vector<string>>> axes;
+
+public:
+    explicit Sweep(const Config& config);
+
+    int size() const;
+    Config point(int i) const;     // the i-th combination, first axis varying slowest
+    string describe(int i) const;  // "key=value ..." of the swept keys only
+};
+
+// On-disk results keyed by RunSpec::hash(). <dir>/<hash in hex>/ holds a finished run's
+// output files and its canonical spec; runs are written to a scratch directory and renamed
+// into place, so a result directory is only ever complete.
+class ResultCache {
+private:
+    string dir;
+
+public:
+    explicit ResultCache(const string& dir);
+
+    string path(const RunSpec& spec) const;
+    // Also compares the stored spec, so a hash collision is a miss rather than a wrong result
+    bool contains(const RunSpec& spec) const;
+    void store(const RunSpec& spec) const;
+};
+
+// Runs every point of the sweep in `config` on `workers` threads ("workers" key, default one
+// per core), skipping points already in the cache ("cache" key, default ../../data/cache).
+// A single run without a "cache" key writes to the usual data directory instead.
+// Prints one "hash status swept-keys" line per point; returns the number of failed points.
+int runSweep(const Config& config);
+
+#endif //SWEEP_H
@@ -0,0 +1,28 @@
+#include <iostream>
+#include <stdexcept>
+#include "Config.h"
+#include "Sweep.h"
+#include "writer.h"
+#include "Profiler.h"
+using namespace std;
+
+// Headless counterpart of src/main.cpp: reads a run description, runs only the
+// solvers it lists and never touches raylib. See src/batch/example.cfg for the keys.
+const int MAX_POINTS = 2000;
+const int WIDTH = 1200;
+const int HEIGHT = 1200;
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        cerr << "usage: billiards_batch <config>\n";
+        return 2;
+    }
+    try {
+        int failed = runSweep(Config::load(argv[1]));
+        PROFILE_REPORT(data_path("profile_report.json", "../../data/"));
+        return failed == 0 ? 0 : 1;
+    } catch (const exception& e) {
+        cerr << "billiards_batch: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Eigenbasis.h"
+#include "Ensemble.h"
+#include "MagneticBilliard.h"
+#include "Philox.h"
+#include "Schrodinger.h"
+#include "SinaiBilliard.h"
+#include "ThreadPool.h"
+#include "writer.h"
+using namespace std;
+
+// Micro and macro benchmarks for the simulation hot paths.
+//   billiards_bench [--filter s] [--min-time sec] [--out file.json]
+//                   [--baseline file.json] [--tolerance 0.10]
+// Results are written as JSON (stdout by default). With --baseline every benchmark is
+// compared against the saved run and the exit code is 1 if any got slower than tolerance.
+// The Philox generator is checked against its known-answer vectors, and magnetic flights
+// for leaks out of closed tables, before anything runs.
+const int MAX_POINTS = 500;
+const int WIDTH = 1200;
+const int HEIGHT = 1200;
+
+static volatile double sink; // keeps results alive so the measured work is not optimised out
+
+struct Result {
+    string name;
+    double ns_per_op;     // median over the repetitions
+    double items_per_op;  // bounces, cells, ... handled by one call
+    long long iterations; // calls per repetition
+};
+
+struct Options {
+    string filter;
+    double min_time = 0.2; // seconds per repetition
+    int repetitions = 5;
+};
+
+static Result measure(const Options& options, const string& name, double items_per_op,
+                      const function<void()>& op) {
+    using clock = chrono::steady_clock;
+    auto run = [&](long long n) {
+        auto t0 = clock::now();
+        for (long long k = 0; k < n; k++) op();
+        return chrono::duration<double>(clock::now() - t0).count();
+    };
+
+    // Warm up, then grow the batch until one repetition takes min_time
+    double t = run(1);
+    long long n = 1;
+    while (t < options.min_time && n < (1LL << 40)) {
+        long long next = t > 0 ? static_cast<long long>(n * 1.4 * options.min_time / t) : n * 10;
+        n = min(max(next, n + 1), n * 100);
+        t = run(n);
+    }
+
+    vector<double> samples = {t / n};
+    for (int r = 1; r < options.repetitions; r++) samples.push_back(run(n) / n);
+    sort(samples.begin(), samples.end());
+    return {name, samples[samples.size() / 2] * 1e9, items_per_op, n};
+}
+
+// --- Self-checks ---
+
+// Particles that leave a closed table in a magnetic field: a flight that finds no wall
+// or whose midpoint is outside. Orbits here are larger than the table, so every flight
+// has to end on a wall.
+static int magneticLeaks(const SinaiBilliard& billiard, double field, int count, int bounces) {
+    MagneticBilliard magnetic(billiard, field);
+    int leaks = 0;
+    for (int j = 0; j < count; j++) {
+        double angle = 2 * M_PI * (j + 0.5) / count;
+        Vec2 p(10, 20), d(cos(angle), sin(angle)), arrival;
+        int surface = -1;
+        for (int t = 0; t < bounces; t++) {
+            Hit hit = magnetic.intersect(p, d, surface);
+            if (hit.surface < 0 || !billiard.contains(magnetic.advance(p, d, hit.t / 2, arrival))) {
+                leaks++;
+                break;
+            }
+            magnetic.advance(p, d, hit.t, arrival);
+            p = hit.point;
+            d = next_reflection(arrival, hit).normalize();
+            surface = hit.surface;
+        }
+    }
+    return leaks;
+}
+
+// --- Fixtures ---
+
+static SinaiBilliard makeTable(int scatterers, mt19937_64& rng) {
+    SinaiBilliard billiard(300, 300, 100, 0);
+    uniform_real_distribution<double> x(-350, 350), y(-250, 250);
+    vector<Circle> circles;
+    for (int k = 0; k < scatterers; k++) circles.push_back({{x(rng), y(rng)}, 2});
+    billiard.addScatterers(circles);
+    return billiard;
+}
+
+// Start points inside the table and clear of every scatterer, with random directions
+static void makeRays(const SinaiBilliard& billiard, int n, mt19937_64& rng, vector<Vec2>& ps, vector<Vec2>& ds) {
+    uniform_real_distribution<double> x(-250, 250), y(-200, 200), angle(0, 2 * M_PI);
+    while (static_cast<int>(ps.size()) < n) {
+        Vec2 p(x(rng), y(rng));
+        bool clear = true;
+        for (const auto& c : billiard.getScatterers()) clear = clear && (p - c.center).mag() > c.radius + 1e-6;
+        if (!clear) continue;
+        double a = angle(rng);
+        ps.push_back(p);
+        ds.emplace_back(cos(a), sin(a));
+    }
+}
+
+// --- Baseline ---
+
+// Reads back the "name" / "ns_per_op" pairs of a file written by this program
+static map<string, double> loadBaseline(const string& path) {
+    map<string, double> baseline;
+    ifstream in(path);
+    if (!in) throw runtime_error("cannot open baseline " + path);
+    string line;
+    while (getline(in, line)) {
+        size_t n = line.find("\"name\": \"");
+        size_t v = line.find("\"ns_per_op\": ");
+        if (n == string::npos || v == string::npos) continue;
+        n += 9;
+        string name = line.substr(n, line.find('"', n) - n);
+        baseline[name] = stod(line.substr(v + 13));
+    }
+    return baseline;
+}
+
+static string toJson(const vector<Result>& results) {
+    stringstream out;
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "    {\"name\": \"%s\", \"ns_per_op\": %.6g, \"items_per_second\": %.6g, \"iterations\": %lld}%s\n",
+                 r.name.c_str(), r.ns_per_op, r.items_per_op / (r.ns_per_op * 1e-9), r.iterations,
+                 i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    string out_path, baseline_path;
+    double tolerance = 0.10;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--filter" && has_value) options.filter = argv[++i];
+        else if (arg == "--min-time" && has_value) options.min_time = stod(argv[++i]);
+        else if (arg == "--repetitions" && has_value) options.repetitions = max(1, stoi(argv[++i]));
+        else if (arg == "--out" && has_value) out_path = argv[++i];
+        else if (arg == "--baseline" && has_value) baseline_path = argv[++i];
+        else if (arg == "--tolerance" && has_value) tolerance = stod(argv[++i]);
+        else {
+            cerr << "usage: billiards_bench [--filter s] [--min-time sec] [--repetitions n]"
+                    " [--out file.json] [--baseline file.json] [--tolerance 0.10]\n";
+            return 2;
+        }
+    }
+
+    if (!Philox::knownAnswers()) {
+        cerr << "billiards_bench: Philox4x32-10 does not match the Random123 known answers\n";
+        return 1;
+    }
+    int leaks = magneticLeaks(SinaiBilliard(400, 500, 0, 0), 5e-5, 64, 200)
+              + magneticLeaks(SinaiBilliard(200, 400, 150, 0), 1e-3, 64, 200);
+    if (leaks > 0) {
+        cerr << "billiards_bench: " << leaks << " magnetic particles left a closed table\n";
+        return 1;
+    }
+    if (!Eigenbasis::matchesDense()) {
+        cerr << "billiards_bench: the Spectra eigenbasis does not match a dense solve\n";
+        return 1;
+    }
+
+    vector<Result> results;
+    auto bench = [&](const string& name, double items_per_op, const function<void()>& op) {
+        if (name.find(options.filter) == string::npos) return;
+        results.push_back(measure(options, name, items_per_op, op));
+        cerr << name << ": " << results.back().ns_per_op << " ns/op\n";
+    };
+    mt19937_64 rng(12345);
+
+    // --- Ray queries ---
+    for (int scatterers : {0, 16, 256, 4096}) {
+        SinaiBilliard billiard = makeTable(scatterers, rng);
+        vector<Vec2> ps, ds;
+        makeRays(billiard, 1024, rng, ps, ds);
+        size_t k = 0;
+        bench("intersect/scatterers:" + to_string(scatterers), 1, [&] {
+            Vec2 q = billiard.getIntersectionPoint(ps[k], ds[k]);
+            sink = sink + q.x;
+            k = (k + 1) & 1023;
+        });
+
+        Ensemble ensemble(billiard);
+        for (size_t j = 0; j < ps.size(); j++) ensemble.add(ps[j], ds[j]);
+        bench("ensemble_step/scatterers:" + to_string(scatterers), ensemble.size(), [&] {
+            ensemble.step();
+            sink = sink + ensemble.getX()[0];
+        });
+    }
+
+    // --- Normals at boundary points ---
+    {
+        SinaiBilliard billiard = makeTable(0, rng);
+        const Billiard& outer = billiard.getOuter();
+        vector<Vec2> ps, ds;
+        makeRays(billiard, 1024, rng, ps, ds);
+        vector<Hit> hits;
+        for (size_t j = 0; j < ps.size(); j++) hits.push_back(outer.intersect(ps[j], ds[j]));
+        size_t k = 0;
+        bench("normal/point", 1, [&] {
+            Vec2 n = outer.getNormal(hits[k].point);
+            sink = sink + n.x;
+            k = (k + 1) & 1023;
+        });
+        bench("normal/surface", 1, [&] {
+            Vec2 n = outer.getNormal(hits[k].surface, hits[k].point);
+            sink = sink + n.x;
+            k = (k + 1) & 1023;
+        });
+    }
+
+    // --- Quantum kernels ---
+    for (double dh : {8.0, 4.0}) {
+        SinaiBilliard billiard(400, 500, 0, 0);
+        int nx = static_cast<int>(WIDTH / dh), ny = static_cast<int>(HEIGHT / dh);
+        vector<int> boundary;
+        bench("boundary/dh:" + to_string(static_cast<int>(dh)), nx * ny, [&] {
+            boundary = billiard.getBoundary(WIDTH, HEIGHT, dh);
+            sink = sink + boundary[0];
+        });
+        boundary = billiard.getBoundary(WIDTH, HEIGHT, dh);
+
+        Schrodinger schrodinger(nx, ny, dh, 3, 10);
+        vector<complex<double>> psi = schrodinger.gaussian_packet(nx, ny, 0, 0, 100, 1.0);
+        vector<complex<double>> result(psi.size());
+        bench("laplacian/dh:" + to_string(static_cast<int>(dh)), nx * ny, [&] {
+            schrodinger.laplacian_inplace(psi, boundary, result, nx, ny);
+            sink = sink + result[0].real();
+        });
+        Stencil stencil(nx, ny, dh, boundary);
+        SplitField split = stencil.field(), lap = stencil.field();
+        stencil.load(psi, split);
+        bench("stencil/dh:" + to_string(static_cast<int>(dh)), nx * ny, [&] {
+            stencil.laplacian(split, lap);
+            sink = sink + lap.re[stencil.index(nx / 2, ny / 2)];
+        });
+        bench("rk4/dh:" + to_string(static_cast<int>(dh)), nx * ny, [&] {
+            vector<complex<double>> next = schrodinger.RK4_Schrodinger(psi, stencil);
+            sink = sink + next[0].real();
+        });
+        SplitField state = stencil.field();
+        stencil.load(psi, state);
+        bench("rk4_inplace/dh:" + to_string(static_cast<int>(dh)), nx * ny, [&] {
+            schrodinger.RK4_inplace(stencil, state);
+            sink = sink + state.re[stencil.index(nx / 2, ny / 2)];
+        });
+        ThreadPool inline_pool(1);
+        bench("rk4_bands/dh:" + to_string(static_cast<int>(dh)), nx * ny, [&] {
+            schrodinger.RK4_inplace(stencil, state, inline_pool);
+            sink = sink + state.re[stencil.index(nx / 2, ny / 2)];
+        });
+        // One writer frame, ten RK4 steps' worth of time
+        bench("chebyshev/dh:" + to_string(static_cast<int>(dh)), 10.0 * nx * ny, [&] {
+            schrodinger.Chebyshev_inplace(stencil, state, 30, 1e-12);
+            sink = sink + state.re[stencil.index(nx / 2, ny / 2)];
+        });
+    }
+
+    // --- Writers, end to end, into a scratch directory ---
+    string scratch = (filesystem::temp_directory_path() / "billiards_bench").string();
+    filesystem::create_directories(scratch);
+    set_data_directory(scratch);
+    {
+        SinaiBilliard billiard = makeTable(16, rng);
+        const int count = 256;
+        bench("write_classical/count:256", static_cast<double>(count) * MAX_POINTS, [&] {
+            vector<vector<Vec2>> trajectories = write_classical(billiard, {0, 0}, 0.3, count);
+            sink = sink + trajectories[0][0].x;
+        });
+        SinaiBilliard quantum(400, 500, 0, 0);
+        int nx = WIDTH / 16, ny = HEIGHT / 16;
+        bench("write_quantum/dh:16", 10.0 * MAX_POINTS * nx * ny, [&] {
+            vector<vector<float>> densities = write_quantum(16, 3, 10, 0, 0, 100, 1.0, quantum);
+            sink = sink + densities[0][0];
+        });
+    }
+    set_data_directory("");
+    filesystem::remove_all(scratch);
+
+    string json = toJson(results);
+    if (out_path.empty()) {
+        cout << json;
+    } else {
+        ofstream(out_path) << json;
+    }
+
+    if (baseline_path.empty()) return 0;
+
+    // --- Comparison: ratio > 1 means slower than the baseline ---
+    map<string, double> baseline = loadBaseline(baseline_path);
+    int regressions = 0;
+    for (const Result& r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end()) {
+            fprintf(stderr, "%-32s %12.1f ns/op   (no baseline)\n", r.name.c_str(), r.ns_per_op);
+            continue;
+        }
+        double ratio = r.ns_per_op / it->second;
+        bool slower = ratio > 1 + tolerance;
+        regressions += slower ? 1 : 0;
+        fprintf(stderr, "%-32s %12.1f ns/op   baseline %12.1f   x%.3f%s\n", r.name.c_str(), r.ns_per_op,
+                it->second, ratio, slower ? "   REGRESSION" : "");
+    }
+    return regressions > 0 ? 1 : 0;
+}
@@ -2,17 +2,198 @@
 #include <vector>
 #include <iostream>
 #include "Vec2.h"
+#ifndef BILLIARDS_HEADLESS
 #include "raylib.h"
+#endif
 #include "Utils.h"
+#include <limits>
+#include <algorithm>
+#include <numeric>
 
 double epsilon = 1e-9;
 double pi = M_PI;
 
+template <> Hit Billiard::intersectKernel<Billiard::CIRCLE>(Vec2 p, Vec2 d) const;
+template <> Hit Billiard::intersectKernel<Billiard::ELLIPSE>(Vec2 p, Vec2 d) const;
+template <> Hit Billiard::intersectKernel<Billiard::STADIUM>(Vec2 p, Vec2 d) const;
+template <> Hit Billiard::intersectKernel<Billiard::RECTANGLE>(Vec2 p, Vec2 d) const;
+template <> Hit Billiard::intersectKernel<Billiard::GENERAL>(Vec2 p, Vec2 d) const;
+template <> Hit Billiard::intersectKernel<Billiard::EDGES>(Vec2 p, Vec2 d) const;
+
+// --- Edge ---
+
+Edge Edge::segment(Vec2 p0, Vec2 p1) {
+    Edge e;
+    e.p0 = p0;
+    e.p1 = p1;
+    return e;
+}
+
+Edge Edge::ellipticArc(Vec2 center, double rx, double ry, double start, double sweep) {
+    Edge e;
+    e.arc = true;
+    e.center = center;
+    e.rx = rx;
+    e.ry = ry;
+    e.start = start;
+    e.sweep = sweep;
+    e.p0 = e.pointAt(start);
+    e.p1 = e.pointAt(start + sweep);
+    return e;
+}
+
+Vec2 Edge::pointAt(double angle) const {
+    return {center.x + rx * cos(angle), center.y + ry * sin(angle)};
+}
+
+bool Edge::degenerate() const {
+    return arc ? (rx <= 0 || ry <= 0 || sweep == 0) : p0 == p1;
+}
+
 Billiard::Billiard(double a, double b, double l, double h) {
     this->a = a; // Horizontal radius
     this->b = b; // Vertical radius
     this->l = l; // Horizontal component of the rectangular area
     this->h = h; // Vertical component of the rectangular area
+
+    a2 = a * a;
+    b2 = b * b;
+    a2b2 = a2 * b2;
+
+    // The same table as an edge list, in Surface order, walked counter-clockwise from the
+    // bottom of the right-hand flat
+    walk = {RIGHT, TOP_RIGHT, TOP, TOP_LEFT, LEFT, BOTTOM_LEFT, BOTTOM, BOTTOM_RIGHT};
+    edges = {
+        Edge::segment({l, h + b}, {-l, h + b}),       // top
+        Edge::segment({-l, -h - b}, {l, -h - b}),     // bottom
+        Edge::segment({-l - a, h}, {-l - a, -h}),     // left
+        Edge::segment({l + a, -h}, {l + a, h}),       // right
+        Edge::ellipticArc({-l, h}, a, b, pi / 2, pi / 2),
+        Edge::ellipticArc({l, h}, a, b, 0, pi / 2),
+        Edge::ellipticArc({l, -h}, a, b, 3 * pi / 2, pi / 2),
+        Edge::ellipticArc({-l, -h}, a, b, pi, pi / 2)
+    };
+    compileEdges();
+
+    // Quarter arcs
+    const Vec2 c[4] = {{-l, h}, {l, h}, {l, -h}, {-l, -h}};
+    const Vec2 s[4] = {{-1, 1}, {1, 1}, {1, -1}, {-1, -1}};
+    for (int i = 0; i < 4; i++) {
+        centers[i] = c[i];
+        quadrants[i] = s[i];
+    }
+
+    // Pick the kernel once
+    if (a == 0 && b == 0)       shape = RECTANGLE;
+    else if (l == 0 && h == 0)  shape = (a == b) ? CIRCLE : ELLIPSE;
+    else if (a == b)            shape = STADIUM;
+    else                        shape = GENERAL;
+
+    switch (shape) {
+        case CIRCLE:    kernel = &Billiard::intersectKernel<CIRCLE>; break;
+        case ELLIPSE:   kernel = &Billiard::intersectKernel<ELLIPSE>; break;
+        case STADIUM:   kernel = &Billiard::intersectKernel<STADIUM>; break;
+        case RECTANGLE: kernel = &Billiard::intersectKernel<RECTANGLE>; break;
+        case GENERAL:   kernel = &Billiard::intersectKernel<GENERAL>; break;
+        default: break;
+    }
+}
+
+Billiard::Billiard(const vector<Edge>& edges)
+    : a(0), b(0), l(0), h(0), shape(EDGES), edges(edges), walk(edges.size()),
+      centers(), quadrants(), a2(0), b2(0), a2b2(0) {
+    // Edge lists are given counter-clockwise already
+    iota(walk.begin(), walk.end(), 0);
+    compileEdges();
+    kernel = &Billiard::intersectKernel<EDGES>;
+}
+
+bool Billiard::onArc(const PackedArc& arc, Vec2 u) {
+    double c1 = arc.from * u;
+    double c2 = u * arc.to;
+    if (arc.wide) return !(c1 < -epsilon && c2 < -epsilon);
+    return c1 >= -epsilon && c2 >= -epsilon;
+}
+
+void Billiard::compileEdges() {
+    const double inf = numeric_limits<double>::infinity();
+    lower = {inf, inf};
+    upper = {-inf, -inf};
+    segmentTable.clear();
+    arcTable.clear();
+    packed.assign(edges.size(), 0);
+    vector<double> lengths(edges.size(), 0.0);
+
+    auto grow = [](Vec2& lo, Vec2& hi, Vec2 q) {
+        lo = {min(lo.x, q.x), min(lo.y, q.y)};
+        hi = {max(hi.x, q.x), max(hi.y, q.y)};
+    };
+
+    for (int i = 0; i < static_cast<int>(edges.size()); i++) {
+        const Edge& e = edges[i];
+        if (e.degenerate()) continue;
+
+        if (!e.arc) {
+            Vec2 u = e.p1 - e.p0;
+            lengths[i] = u.mag();
+            packed[i] = static_cast<int>(segmentTable.size());
+            segmentTable.push_back({e.p0, u, Vec2(u.y, -u.x).normalize(), i});
+            grow(lower, upper, e.p0);
+            grow(lower, upper, e.p1);
+            continue;
+        }
+
+        PackedArc arc;
+        arc.center = e.center;
+        arc.rx = e.rx;
+        arc.ry = e.ry;
+        arc.rx2 = e.rx * e.rx;
+        arc.ry2 = e.ry * e.ry;
+        arc.rx2ry2 = arc.rx2 * arc.ry2;
+        double from = e.sweep > 0 ? e.start : e.start + e.sweep;
+        double to = from + abs(e.sweep);
+        arc.from = {cos(from), sin(from)};
+        arc.to = {cos(to), sin(to)};
+        arc.wide = abs(e.sweep) > pi;
+        arc.sign = e.sweep > 0 ? 1 : -1;
+        arc.id = i;
+
+        // End points plus whichever axis extremes the arc passes through
+        arc.lo = {inf, inf};
+        arc.hi = {-inf, -inf};
+        grow(arc.lo, arc.hi, e.p0);
+        grow(arc.lo, arc.hi, e.p1);
+        const Vec2 axes[4] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+        for (Vec2 u : axes) {
+            if (onArc(arc, u)) grow(arc.lo, arc.hi, {e.center.x + e.rx * u.x, e.center.y + e.ry * u.y});
+        }
+        arc.lo = arc.lo - Vec2(epsilon, epsilon);
+        arc.hi = arc.hi + Vec2(epsilon, epsilon);
+        grow(lower, upper, arc.lo);
+        grow(lower, upper, arc.hi);
+
+        // Arc length table, Simpson's rule on each parameter step
+        auto speed = [&](double th) { return sqrt(arc.rx2 * sin(th) * sin(th) + arc.ry2 * cos(th) * cos(th)); };
+        double step = e.sweep / ARC_SAMPLES;
+        arc.lengths.assign(ARC_SAMPLES + 1, 0.0);
+        for (int k = 0; k < ARC_SAMPLES; k++) {
+            double th = e.start + k * step;
+            double ds = abs(step) / 6 * (speed(th) + 4 * speed(th + step / 2) + speed(th + step));
+            arc.lengths[k + 1] = arc.lengths[k] + ds;
+        }
+        lengths[i] = arc.lengths.back();
+
+        packed[i] = -static_cast<int>(arcTable.size()) - 1;
+        arcTable.push_back(arc);
+    }
+
+    // Arc length runs along the walk, so s is continuous and wraps once around the table
+    offsets.assign(edges.size(), 0.0);
+    perimeter = 0;
+    for (int i : walk) {
+        offsets[i] = perimeter;
+        perimeter += lengths[i];
+    }
 }
 
 //Getters
@@ -28,124 +209,80 @@ double Billiard::getL() const {
 double Billiard::getH() const {
     return h;
 }
+Billiard::Shape Billiard::getShape() const {
+    return shape;
+}
+const vector<Edge>& Billiard::getEdges() const {
+    return edges;
+}
+int Billiard::getSurfaces() const {
+    return static_cast<int>(edges.size());
+}
+Vec2 Billiard::getLower() const {
+    return lower;
+}
+Vec2 Billiard::getUpper() const {
+    return upper;
+}
+double Billiard::getPerimeter() const {
+    return perimeter;
+}
 
 //Methods
 Vec2 Billiard::getIntersectionPointHelper(Vec2 p, Vec2 d) const {
-    Vec2 result = getIntersectionPointLines(p, d);
-
-    if (result != p)
-        return result;
-    result = getIntersectionPointCircle(p, d);
-
-    return result;
+    return intersect(p, d).point;
 }
 
 Vec2 Billiard::getIntersectionPointLines(Vec2 p, Vec2 d) const {
-    double top = h + a;
-    double bottom = -h - a;
-    double left = -l - b;
-    double right = l + b;
-
-    double t = 0.0;
-    double k = 0.0;
-
-    double cross;
-    Vec2 sub;
-
-    vector<Vec2> qs = {{left + b, top}, {left + b, bottom},
-                            {left, top - a}, {right, top - a}};
-    vector<Vec2> us = {{2 * l, 0}, {2 * l, 0},
-                            {0,- 2 * h}, {0, -2 * h}};
-
-
-    for (int i = 0; i < 4; i++) {
-        Vec2 q = qs[i];
-        Vec2 u = us[i];
-        cross = d * u;
-        sub = q - p;
-
-        if (abs(cross) < 1e-8) continue;
-
-        t = sub * u / cross;
-        k = sub * d / cross;
-        if (epsilon <= t && 0 <= k && k <= 1) {
-            Vec2 p1 = p + d * t;
-            if (p1 != p) return p1;
-        }
-
-    }
-    return p;
+    Hit hit;
+    hit.t = numeric_limits<double>::infinity();
+    segmentPass(p, d, hit);
+    return hit.surface < 0 ? p : p + d * hit.t;
 }
 
 Vec2 Billiard::getIntersectionPointCircle(Vec2 p, Vec2 d) const {
-    vector<Vec2> centers = {
-        {-l,  h},  // top-left
-        { l,  h},  // top-right
-        { l, -h},  // bottom-right
-        {-l, -h}   // bottom-left
-    };
-
+    Hit hit;
+    hit.t = numeric_limits<double>::infinity();
+    if (a > 0 && b > 0) arcPass<false>(p, d, hit);
+    return hit.surface < 0 ? p : p + d * hit.t;
+}
 
-    if (a == 0 && b == 0) {
-        for (Vec2 c : centers) {
-            double t1 = (c.x - p.x)/d.x;
-            double t2 = (c.y - p.y)/d.y;
-            if (abs(t1 - t2) < epsilon && t1 > epsilon) return c;
+int Billiard::nearestSurface(Vec2 p) const {
+    int nearest = -1;
+    double best = numeric_limits<double>::infinity();
+    for (const auto& seg : segmentTable) {
+        double k = max(0.0, min(1.0, (p - seg.q).dot(seg.u) / seg.u.dot(seg.u)));
+        double dist = (p - (seg.q + seg.u * k)).mag();
+        if (dist < best) {
+            best = dist;
+            nearest = seg.id;
         }
     }
-
-    double A = 0;
-    double B = 0;
-    double C = 0;
-    double D = 0;
-
-    for (int i = 0; i < 4; i++) {
-        Vec2 c = centers[i];
-
-        A = b * b * d.x * d.x + a * a * d.y * d.y;
-        B = 2 * (b * b * d.x * (p.x - c.x) + a * a * d.y * (p.y - c.y));
-        C = b * b * pow(p.x - c.x, 2) + a * a * pow(p.y - c.y, 2) - pow(a * b, 2);
-        D = sqrt(B * B - 4 * A * C);
-
-        if (D < 0) continue;
-
-        double t1 = (-B + D) / (2 * A);
-        double t2 = (-B - D) / (2 * A);
-
-        if (t1 > 0) {
-            Vec2 new_p = p + d * t1;
-            bool inQuarter = false;
-            switch (i) {
-                case 0: inQuarter = (new_p.x <= c.x && new_p.y <= c.y); break; // top-left
-                case 1: inQuarter = (new_p.x >= c.x && new_p.y <= c.y); break; // top-right
-                case 2: inQuarter = (new_p.x >= c.x && new_p.y >= c.y); break; // bottom-right
-                case 3: inQuarter = (new_p.x <= c.x && new_p.y >= c.y); break; // bottom-left
-            }
-            if (inQuarter) {
-                return new_p;
-            }
-        }
-        else if (t2 > 0) {
-            Vec2 new_p = p + d * t2;
-            bool inQuarter = false;
-            switch (i) {
-                case 0: inQuarter = (new_p.x <= c.x && new_p.y <= c.y); break; // top-left
-                case 1: inQuarter = (new_p.x >= c.x && new_p.y <= c.y); break; // top-right
-                case 2: inQuarter = (new_p.x >= c.x && new_p.y >= c.y); break; // bottom-right
-                case 3: inQuarter = (new_p.x <= c.x && new_p.y >= c.y); break; // bottom-left
-            }
-            if (inQuarter) {
-                return new_p;
-            }
+    for (const auto& arc : arcTable) {
+        // Off the arc's angular range the nearest point is an end point; on it, the radial
+        // gap in the unit circle's frame, which is exact on the boundary itself
+        Vec2 u((p.x - arc.center.x) / arc.rx, (p.y - arc.center.y) / arc.ry);
+        double r = u.mag();
+        const Edge& e = edges[arc.id];
+        double dist = r > 0 && onArc(arc, u / r) ? abs(r - 1) * min(arc.rx, arc.ry)
+                                                 : min((p - e.p0).mag(), (p - e.p1).mag());
+        if (dist < best) {
+            best = dist;
+            nearest = arc.id;
         }
     }
-    return p;
+    return nearest;
 }
 
 Vec2 Billiard::getNormal(Vec2 p) const {
+    // Edge tables have no quarter arcs: find the edge p lies on
+    if (shape == EDGES) {
+        int surface = nearestSurface(p);
+        return surface < 0 ? Vec2(0, 0) : getNormal(surface, p);
+    }
+
     // Lines
     if (p.x > - l && p.x < l) {
-        double th = -h;
         if (p.y >= h - epsilon) return {0, 1};
         if (p.y <= -h + epsilon) return {0, -1};
     }
@@ -154,13 +291,6 @@ Vec2 Billiard::getNormal(Vec2 p) const {
         if (p.x <= -l + epsilon) return {-1, 0};
     }
 
-    vector<Vec2> centers = {
-        {-l, h},  // top-left
-        { l, h},  // top-right
-        { l,  -h},  // bottom-right
-        {-l,  -h}   // bottom-left
-    };
-
     for (int i = 0; i < 4; i++) {
         Vec2 c = centers[i];
         bool inQuarter = false;
@@ -175,22 +305,321 @@ Vec2 Billiard::getNormal(Vec2 p) const {
                 return {(p.x > 0 ? 1.0 : -1.0),
                        (p.y > 0 ? 1.0 : -1.0) };
             }
-            return {(b * b * (p.x - c.x)), (a * a * (p.y - c.y))};
+            return {(b2 * (p.x - c.x)), (a2 * (p.y - c.y))};
+        }
+    }
+    return {0, 0};
+}
+
+Vec2 Billiard::getNormal(int surface, Vec2 p) const {
+    if (shape == EDGES) {
+        int k = packed[surface];
+        if (k >= 0) return segmentTable[k].normal;
+
+        const PackedArc& arc = arcTable[-k - 1];
+        Vec2 f = p - arc.center;
+        return Vec2(arc.ry2 * f.x, arc.rx2 * f.y).normalize() * arc.sign;
+    }
+
+    switch (surface) {
+        case TOP:    return {0, 1};
+        case BOTTOM: return {0, -1};
+        case LEFT:   return {-1, 0};
+        case RIGHT:  return {1, 0};
+        default: break;
+    }
+
+    Vec2 c = centers[surface - TOP_LEFT];
+    return Vec2(b2 * (p.x - c.x), a2 * (p.y - c.y)).normalize();
+}
+
+double Billiard::getArcLength(int surface, Vec2 p) const {
+    const Edge& e = edges[surface];
+    if (!e.arc) return offsets[surface] + (p - e.p0).mag();
+
+    // Parameter angle travelled from the start, snapped onto the arc
+    const PackedArc& arc = arcTable[-packed[surface] - 1];
+    double phi = atan2((p.y - e.center.y) / e.ry, (p.x - e.center.x) / e.rx);
+    double sweep = abs(e.sweep);
+    double delta = fmod(e.sweep > 0 ? phi - e.start : e.start - phi, 2 * pi);
+    if (delta < 0) delta += 2 * pi;
+    if (delta > sweep) delta = (delta - sweep < 2 * pi - delta) ? sweep : 0;
+
+    double x = delta / sweep * ARC_SAMPLES;
+    int k = min(static_cast<int>(x), ARC_SAMPLES - 1);
+    return offsets[surface] + arc.lengths[k] + (arc.lengths[k + 1] - arc.lengths[k]) * (x - k);
+}
+
+Vec2 Billiard::getPoint(double s, int& surface) const {
+    s = fmod(s, getPerimeter());
+    if (s < 0) s += getPerimeter();
+
+    // Last edge along the walk starting at or before s; degenerate edges have no length
+    // and are passed over
+    surface = -1;
+    for (int i : walk) {
+        if (edges[i].degenerate()) continue;
+        if (surface >= 0 && offsets[i] > s) break;
+        surface = i;
+    }
+    const Edge& e = edges[surface];
+    double along = s - offsets[surface];
+    if (!e.arc) return e.p0 + (e.p1 - e.p0) * (along / (e.p1 - e.p0).mag());
+
+    // Invert the arc length table, linear within a parameter step
+    const PackedArc& arc = arcTable[-packed[surface] - 1];
+    int k = static_cast<int>(upper_bound(arc.lengths.begin(), arc.lengths.end(), along) - arc.lengths.begin()) - 1;
+    k = min(max(k, 0), ARC_SAMPLES - 1);
+    double step = arc.lengths[k + 1] - arc.lengths[k];
+    double x = k + (step > 0 ? (along - arc.lengths[k]) / step : 0);
+    return e.pointAt(e.start + e.sweep * min(x, static_cast<double>(ARC_SAMPLES)) / ARC_SAMPLES);
+}
+
+double Billiard::getCurvature(int surface, Vec2 p) const {
+    if (!edges[surface].arc) return 0;
+
+    // Ellipse curvature rx ry / (rx^2 sin^2 + ry^2 cos^2)^(3/2) at the parameter angle of p.
+    // A counter-clockwise arc bulges outwards and focuses; a clockwise one disperses.
+    const PackedArc& arc = arcTable[-packed[surface] - 1];
+    double u = (p.x - arc.center.x) / arc.rx;
+    double v = (p.y - arc.center.y) / arc.ry;
+    double g = arc.rx2 * v * v + arc.ry2 * u * u;
+    return -arc.sign * arc.rx * arc.ry / (g * sqrt(g));
+}
+
+bool Billiard::contains(Vec2 p) const {
+    if (shape != EDGES) {
+        // Distance from the flat core [-l, l] x [-h, h], measured in units of the arc radii
+        double fx = p.x - max(-l, min(l, p.x));
+        double fy = p.y - max(-h, min(h, p.y));
+        if ((a == 0 && fx != 0) || (b == 0 && fy != 0)) return false;
+        double u = a > 0 ? fx / a : 0;
+        double v = b > 0 ? fy / b : 0;
+        return u * u + v * v <= 1;
+    }
+
+    // Crossings of the ray from p towards +x, half-open in y so shared end points count once
+    bool inside = false;
+    for (const auto& seg : segmentTable) {
+        Vec2 q0 = seg.q, q1 = seg.q + seg.u;
+        if ((q0.y <= p.y) == (q1.y <= p.y)) continue;
+        double x = q0.x + (p.y - q0.y) / seg.u.y * seg.u.x;
+        if (x > p.x) inside = !inside;
+    }
+    for (const auto& arc : arcTable) {
+        double v = (p.y - arc.center.y) / arc.ry;
+        if (v <= -1 || v >= 1) continue;
+        double w = sqrt(1 - v * v);
+        for (double u : {-w, w}) {
+            if (arc.center.x + arc.rx * u > p.x && onArc(arc, {u, v})) inside = !inside;
+        }
+    }
+    return inside;
+}
+
+// --- Kernel building blocks ---
+
+void Billiard::segmentPass(Vec2 p, Vec2 d, Hit& hit) const {
+    // p + t * d = q + k * u
+    for (const auto& seg : segmentTable) {
+        double cross = d * seg.u;
+        if (abs(cross) < 1e-12) continue; // parallel
+
+        Vec2 sub = seg.q - p;
+        double t = sub * seg.u / cross;
+        double k = sub * d / cross;
+        if (t > epsilon && t < hit.t && k >= -epsilon && k <= 1 + epsilon) {
+            hit.t = t;
+            hit.surface = seg.id;
+        }
+    }
+}
+
+template <bool Circular>
+void Billiard::arcPass(Vec2 p, Vec2 d, Hit& hit) const {
+    // From inside the table a ray only ever leaves an arc's ellipse, so the far root is the candidate
+    const double A = Circular ? 1.0 : b2 * d.x * d.x + a2 * d.y * d.y;
+    for (int i = 0; i < 4; i++) {
+        Vec2 f = p - centers[i];
+        double B, C;
+        if (Circular) {
+            B = 2 * f.dot(d);
+            C = f.dot(f) - a2;
+        } else {
+            B = 2 * (b2 * d.x * f.x + a2 * d.y * f.y);
+            C = b2 * f.x * f.x + a2 * f.y * f.y - a2b2;
+        }
+        double disc = B * B - 4 * A * C;
+        if (disc < 0) continue;
+
+        double t = (-B + sqrt(disc)) / (2 * A);
+        Vec2 r = f + d * t;
+        if (t > epsilon && t < hit.t
+            && quadrants[i].x * r.x >= -epsilon && quadrants[i].y * r.y >= -epsilon) {
+            hit.t = t;
+            hit.surface = TOP_LEFT + i;
+        }
+    }
+}
+
+void Billiard::edgeArcPass(Vec2 p, Vec2 d, Hit& hit) const {
+    for (const auto& arc : arcTable) {
+        // Cull on the bounding box over (0, hit.t)
+        double t_in = 0, t_out = hit.t;
+        if (d.x != 0) {
+            double ta = (arc.lo.x - p.x) / d.x, tb = (arc.hi.x - p.x) / d.x;
+            t_in = max(t_in, min(ta, tb));
+            t_out = min(t_out, max(ta, tb));
+        } else if (p.x < arc.lo.x || p.x > arc.hi.x) {
+            continue;
+        }
+        if (d.y != 0) {
+            double ta = (arc.lo.y - p.y) / d.y, tb = (arc.hi.y - p.y) / d.y;
+            t_in = max(t_in, min(ta, tb));
+            t_out = min(t_out, max(ta, tb));
+        } else if (p.y < arc.lo.y || p.y > arc.hi.y) {
+            continue;
+        }
+        if (t_in > t_out) continue;
+
+        // The ray may enter or leave the ellipse on the arc, so both roots are candidates
+        Vec2 f = p - arc.center;
+        double A = arc.ry2 * d.x * d.x + arc.rx2 * d.y * d.y;
+        double B = 2 * (arc.ry2 * d.x * f.x + arc.rx2 * d.y * f.y);
+        double C = arc.ry2 * f.x * f.x + arc.rx2 * f.y * f.y - arc.rx2ry2;
+        double disc = B * B - 4 * A * C;
+        if (disc < 0) continue;
+
+        double sq = sqrt(disc);
+        const double roots[2] = {(-B - sq) / (2 * A), (-B + sq) / (2 * A)};
+        for (double t : roots) {
+            if (t <= epsilon || t >= hit.t) continue;
+            Vec2 r = f + d * t;
+            if (onArc(arc, {r.x / arc.rx, r.y / arc.ry})) {
+                hit.t = t;
+                hit.surface = arc.id;
+                break;
+            }
         }
     }
 }
 
+Hit Billiard::finish(Vec2 p, Vec2 d, Hit hit) const {
+    if (hit.surface < 0) {
+        hit.t = 0;
+        hit.point = p;
+        return hit;
+    }
+    hit.point = p + d * hit.t;
+    hit.normal = getNormal(hit.surface, hit.point);
+    return hit;
+}
+
+// --- Kernels, one per Shape ---
+
+template <>
+Hit Billiard::intersectKernel<Billiard::EDGES>(Vec2 p, Vec2 d) const {
+    Hit hit;
+    hit.t = numeric_limits<double>::infinity();
+    segmentPass(p, d, hit);
+    edgeArcPass(p, d, hit);
+    return finish(p, d, hit);
+}
+
+template <>
+Hit Billiard::intersectKernel<Billiard::CIRCLE>(Vec2 p, Vec2 d) const {
+    Hit hit;
+    double B = p.dot(d);
+    double disc = B * B - (p.dot(p) - a2);
+    if (disc < 0) return finish(p, d, hit);
+
+    hit.t = -B + sqrt(disc);
+    hit.point = p + d * hit.t;
+    hit.normal = hit.point / a;
+    hit.surface = hit.point.y >= 0 ? (hit.point.x < 0 ? TOP_LEFT : TOP_RIGHT)
+                                   : (hit.point.x < 0 ? BOTTOM_LEFT : BOTTOM_RIGHT);
+    return hit;
+}
+
+template <>
+Hit Billiard::intersectKernel<Billiard::ELLIPSE>(Vec2 p, Vec2 d) const {
+    Hit hit;
+    double A = b2 * d.x * d.x + a2 * d.y * d.y;
+    double B = 2 * (b2 * d.x * p.x + a2 * d.y * p.y);
+    double C = b2 * p.x * p.x + a2 * p.y * p.y - a2b2;
+    double disc = B * B - 4 * A * C;
+    if (disc < 0) return finish(p, d, hit);
+
+    hit.t = (-B + sqrt(disc)) / (2 * A);
+    hit.point = p + d * hit.t;
+    hit.normal = Vec2(b2 * hit.point.x, a2 * hit.point.y).normalize();
+    hit.surface = hit.point.y >= 0 ? (hit.point.x < 0 ? TOP_LEFT : TOP_RIGHT)
+                                   : (hit.point.x < 0 ? BOTTOM_LEFT : BOTTOM_RIGHT);
+    return hit;
+}
+
+template <>
+Hit Billiard::intersectKernel<Billiard::STADIUM>(Vec2 p, Vec2 d) const {
+    Hit hit;
+    hit.t = numeric_limits<double>::infinity();
+    segmentPass(p, d, hit);
+    arcPass<true>(p, d, hit);
+    return finish(p, d, hit);
+}
+
+template <>
+Hit Billiard::intersectKernel<Billiard::RECTANGLE>(Vec2 p, Vec2 d) const {
+    // Exit through the nearer of the two slabs
+    Hit hit;
+    double tx = d.x != 0 ? ((d.x > 0 ? l : -l) - p.x) / d.x : numeric_limits<double>::infinity();
+    double ty = d.y != 0 ? ((d.y > 0 ? h : -h) - p.y) / d.y : numeric_limits<double>::infinity();
+    if (tx < ty) {
+        hit.t = tx;
+        hit.surface = d.x > 0 ? RIGHT : LEFT;
+    } else {
+        hit.t = ty;
+        hit.surface = d.y > 0 ? TOP : BOTTOM;
+    }
+    if (!(hit.t > epsilon) || hit.t == numeric_limits<double>::infinity()) hit.surface = -1;
+    return finish(p, d, hit);
+}
+
+template <>
+Hit Billiard::intersectKernel<Billiard::GENERAL>(Vec2 p, Vec2 d) const {
+    Hit hit;
+    hit.t = numeric_limits<double>::infinity();
+    segmentPass(p, d, hit);
+    arcPass<false>(p, d, hit);
+    return finish(p, d, hit);
+}
+
+#ifndef BILLIARDS_HEADLESS
 void Billiard::draw(double cx, double cy) const{
-    double TOP = cy - a - h;
-    double BOTTOM = cy + a + h;
-    double LEFT = cx - b - l;
-    double RIGHT = cx + b + l;
+    if (shape == EDGES) {
+        // Screen y points down
+        for (const auto& e : edges) {
+            if (e.degenerate()) continue;
+            if (!e.arc) {
+                DrawLine(cx + e.p0.x, cy - e.p0.y, cx + e.p1.x, cy - e.p1.y, WHITE);
+                continue;
+            }
+            double start = -(e.start + e.sweep) * 180.0 / pi;
+            DrawEllipseArc({(float)(cx + e.center.x), (float)(cy - e.center.y)}, e.rx, e.ry,
+                           start, start + e.sweep * 180.0 / pi, 60, WHITE);
+        }
+        return;
+    }
+
+    double TOP = cy - b - h;
+    double BOTTOM = cy + b + h;
+    double LEFT = cx - a - l;
+    double RIGHT = cx + a + l;
 
     // Lines
-    DrawLine(LEFT + b, TOP, RIGHT - b, TOP, WHITE);
-    DrawLine(LEFT + b, BOTTOM, RIGHT - b, BOTTOM, WHITE);
-    DrawLine(LEFT, TOP + a, LEFT, BOTTOM - a, WHITE);
-    DrawLine(RIGHT, TOP + a, RIGHT, BOTTOM - a, WHITE);
+    DrawLine(LEFT + a, TOP, RIGHT - a, TOP, WHITE);
+    DrawLine(LEFT + a, BOTTOM, RIGHT - a, BOTTOM, WHITE);
+    DrawLine(LEFT, TOP + b, LEFT, BOTTOM - b, WHITE);
+    DrawLine(RIGHT, TOP + b, RIGHT, BOTTOM - b, WHITE);
 
     // Arcs
     DrawEllipseArc({(float)(cx - l), (float)(cy + h)}, a, b,  90.0, 180, 60, WHITE);
@@ -198,6 +627,7 @@ void Billiard::draw(double cx, double cy) const{
     DrawEllipseArc({(float)(cx + l), (float)(cy - h)}, a, b,  270.0, 360.0, 60, WHITE);
     DrawEllipseArc({(float)(cx + l), (float)(cy + h)}, a, b, 0, 90.0, 60, WHITE);
 }
+#endif
 
 
 
@@ -6,26 +6,113 @@
 
 using namespace std;
 
+// Result of a single ray query against a boundary
+struct Hit {
+    int surface = -1;  // surface id, -1 if nothing was hit
+    double t = 0;      // flight length along the (unit) direction
+    Vec2 point;        // hit point
+    Vec2 normal;       // unit outward normal at the hit point
+};
+
+// One piece of a general boundary. Edges are listed counter-clockwise around the
+// table, so the outward normal is on the right of the direction of travel.
+struct Edge {
+    bool arc = false;
+    Vec2 p0, p1;                  // segment end points
+    Vec2 center;                  // arc: (x - cx)^2 / rx^2 + (y - cy)^2 / ry^2 = 1
+    double rx = 0, ry = 0;
+    double start = 0, sweep = 0;  // arc: parameter angles in radians, sweep < 0 runs clockwise
+
+    static Edge segment(Vec2 p0, Vec2 p1);
+    static Edge ellipticArc(Vec2 center, double rx, double ry, double start, double sweep);
+    Vec2 pointAt(double angle) const;
+    bool degenerate() const;
+};
+
 class Billiard {
+    public:
+        // Surface ids: the four flat sections, then the four quarter arcs
+        enum Surface { TOP, BOTTOM, LEFT, RIGHT, TOP_LEFT, TOP_RIGHT, BOTTOM_RIGHT, BOTTOM_LEFT, SURFACES };
+        // Special cases of (a, b, l, h) that get their own intersection kernel, and general edge lists
+        enum Shape { CIRCLE, ELLIPSE, STADIUM, RECTANGLE, GENERAL, EDGES };
+
     private:
         double a, b; // ellipse radii (or circle if a == b)
         double l;    // length of the flat section
         double h;    // length of the vertical section (usually == 0)
+
+        // Packed edge tables, degenerate edges left out
+        struct PackedSegment {
+            Vec2 q, u;          // q + k * u, k in [0, 1]
+            Vec2 normal;
+            int id;
+        };
+        struct PackedArc {
+            Vec2 center;
+            double rx, ry, rx2, ry2, rx2ry2;
+            Vec2 from, to;      // unit-circle end points, ordered counter-clockwise
+            bool wide;          // spans more than half a turn
+            double sign;        // +1 counter-clockwise (convex side outwards), -1 clockwise
+            Vec2 lo, hi;        // bounding box
+            int id;
+            vector<double> lengths; // arc length from the start at ARC_SAMPLES even parameter steps
+        };
+        static const int ARC_SAMPLES = 64;
+
+        // Tables precomputed at construction
+        Shape shape;
+        vector<Edge> edges;    // the boundary, indexed by surface id
+        vector<PackedSegment> segmentTable;
+        vector<PackedArc> arcTable;
+        vector<int> packed;    // surface id -> segment k (k >= 0) or arc k (-k - 1)
+        vector<int> walk;      // surface ids in counter-clockwise order around the boundary
+        vector<double> offsets; // arc length at the start of each edge along walk, by surface id
+        double perimeter;
+        Vec2 lower, upper;     // bounding box of the table
+        Vec2 centers[4];       // arc centers, indexed by surface - TOP_LEFT; zero for edge tables
+        Vec2 quadrants[4];     // sign of (x, y) relative to the center on each arc; zero for edge tables
+        double a2, b2, a2b2;
+        Hit (Billiard::*kernel)(Vec2 p, Vec2 d) const;
+
+        template <Shape S> Hit intersectKernel(Vec2 p, Vec2 d) const;
+        void segmentPass(Vec2 p, Vec2 d, Hit& hit) const;
+        template <bool Circular> void arcPass(Vec2 p, Vec2 d, Hit& hit) const;
+        void edgeArcPass(Vec2 p, Vec2 d, Hit& hit) const;
+        Hit finish(Vec2 p, Vec2 d, Hit hit) const;
+        void compileEdges();
+        static bool onArc(const PackedArc& arc, Vec2 u);
+        int nearestSurface(Vec2 p) const; // edge-table surface closest to p
+
     public:
         Billiard(double a, double b, double l, double h);
+        explicit Billiard(const vector<Edge>& edges);
 
         // Getters
         double getA() const;
         double getB() const;
         double getL() const;
         double getH() const;
+        Shape getShape() const;
+        const vector<Edge>& getEdges() const;
+        int getSurfaces() const;
+        Vec2 getLower() const;
+        Vec2 getUpper() const;
+        double getPerimeter() const;
 
         // Methods
         Vec2 getIntersectionPointHelper(Vec2 p, Vec2 d) const;
         Vec2 getIntersectionPointLines(Vec2 p, Vec2 d) const;
         Vec2 getIntersectionPointCircle(Vec2 p, Vec2 d) const;
         Vec2 getNormal(Vec2 p) const;
+        Vec2 getNormal(int surface, Vec2 p) const;
+        double getArcLength(int surface, Vec2 p) const; // counter-clockwise from the start of walk's first edge
+        Vec2 getPoint(double s, int& surface) const;    // inverse of getArcLength, s taken modulo the perimeter
+        double getCurvature(int surface, Vec2 p) const; // > 0 dispersing, < 0 focusing, seen from inside
+        bool contains(Vec2 p) const;
+        Hit intersect(Vec2 p, Vec2 d) const { return (this->*kernel)(p, d); } // d must be a unit vector
+#ifndef BILLIARDS_HEADLESS
         void draw(double cx, double cy) const;
+#endif
 
         // Static methods
         Vec2 static getShortestIntersectionPoint();
@@ -0,0 +1,41 @@
+#include "Birkhoff.h"
+#include <algorithm>
+
+using namespace std;
+
+BirkhoffHistogram::BirkhoffHistogram(int bins_s, int bins_p, double perimeter)
+    : bins_s(bins_s), bins_p(bins_p), perimeter(perimeter),
+      counts(static_cast<size_t>(bins_s) * bins_p, 0), total(0) {}
+
+void BirkhoffHistogram::add(double s, double p) {
+    int i = static_cast<int>(s / perimeter * bins_s);
+    int j = static_cast<int>((p + 1) / 2 * bins_p);
+    i = min(bins_s - 1, max(0, i));
+    j = min(bins_p - 1, max(0, j));
+    counts[static_cast<size_t>(i) * bins_p + j]++;
+    total++;
+}
+
+void BirkhoffHistogram::merge(const BirkhoffHistogram& other) {
+    for (size_t k = 0; k < counts.size(); k++) {
+        counts[k] += other.counts[k];
+    }
+    total += other.total;
+}
+
+// Getters
+int BirkhoffHistogram::getBinsS() const {
+    return bins_s;
+}
+int BirkhoffHistogram::getBinsP() const {
+    return bins_p;
+}
+double BirkhoffHistogram::getPerimeter() const {
+    return perimeter;
+}
+uint64_t BirkhoffHistogram::getTotal() const {
+    return total;
+}
+const vector<uint64_t>& BirkhoffHistogram::getCounts() const {
+    return counts;
+}
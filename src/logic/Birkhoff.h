@@ -0,0 +1,32 @@
+#ifndef BIRKHOFF_H
+#define BIRKHOFF_H
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Fixed-resolution histogram over Birkhoff coordinates (s, p),
+// s in [0, perimeter) and p = sin of the reflection angle in [-1, 1].
+class BirkhoffHistogram {
+private:
+    int bins_s, bins_p;
+    double perimeter;
+    vector<uint64_t> counts; // s-major: counts[i * bins_p + j]
+    uint64_t total;
+
+public:
+    BirkhoffHistogram(int bins_s, int bins_p, double perimeter);
+
+    void add(double s, double p);
+    void merge(const BirkhoffHistogram& other);
+
+    // Getters
+    int getBinsS() const;
+    int getBinsP() const;
+    double getPerimeter() const;
+    uint64_t getTotal() const;
+    const vector<uint64_t>& getCounts() const;
+};
+
+#endif //BIRKHOFF_H
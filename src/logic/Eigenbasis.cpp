@@ -0,0 +1,344 @@
+#include "Eigenbasis.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <Eigen/SparseCore>
+#include <Spectra/SymEigsShiftSolver.h>
+#include <Spectra/MatOp/SparseSymShiftSolve.h>
+#include "ThreadPool.h"
+
+using namespace std;
+
+static const int MAX_ITERATIONS = 1000;
+static const double TOLERANCE = 1e-10;
+
+// -1/2 Lap on the open cells of boundary, numbered in grid order into cells: 2 / dh^2 on
+// the diagonal, -1/(2 dh^2) to each open neighbour
+static Eigen::SparseMatrix<double> hamiltonian(int nx, int ny, double dh, const vector<int>& boundary,
+                                               vector<int>& cells) {
+    vector<int> number(nx * ny, -1);
+    cells.clear();
+    for (int c = 0; c < nx * ny; c++) {
+        if (boundary[c] != 1) {
+            number[c] = static_cast<int>(cells.size());
+            cells.push_back(c);
+        }
+    }
+    int n = static_cast<int>(cells.size());
+    double off = -0.5 / (dh * dh);
+    vector<Eigen::Triplet<double>> entries;
+    entries.reserve(5 * static_cast<size_t>(n));
+    for (int k = 0; k < n; k++) {
+        int i = cells[k] / ny, j = cells[k] % ny;
+        entries.emplace_back(k, k, -4 * off);
+        if (i > 0 && number[cells[k] - ny] >= 0) entries.emplace_back(k, number[cells[k] - ny], off);
+        if (i < nx - 1 && number[cells[k] + ny] >= 0) entries.emplace_back(k, number[cells[k] + ny], off);
+        if (j > 0 && number[cells[k] - 1] >= 0) entries.emplace_back(k, number[cells[k] - 1], off);
+        if (j < ny - 1 && number[cells[k] + 1] >= 0) entries.emplace_back(k, number[cells[k] + 1], off);
+    }
+    Eigen::SparseMatrix<double> H(n, n);
+    H.setFromTriplets(entries.begin(), entries.end());
+    return H;
+}
+
+// One shift-invert solve for the `count` eigenpairs of H nearest shift with an ncv-vector
+// Krylov subspace: the eigenvalues of (H - shift)^-1 largest in magnitude are the ones of
+// H nearest the shift. values and vectors are only filled in on success.
+static Spectra::CompInfo solve(const Eigen::SparseMatrix<double>& H, int count, int ncv, double shift,
+                               int iterations, Eigen::VectorXd& values, Eigen::MatrixXd& vectors) {
+    using Op = Spectra::SparseSymShiftSolve<double>;
+    Op op(H);
+    Spectra::SymEigsShiftSolver<Op> solver(op, count, ncv, shift);
+    solver.init();
+    solver.compute(Spectra::SortRule::LargestMagn, iterations, TOLERANCE, Spectra::SortRule::SmallestAlge);
+    if (solver.info() == Spectra::CompInfo::Successful) {
+        values = solver.eigenvalues();
+        vectors = solver.eigenvectors();
+    }
+    return solver.info();
+}
+
+Eigenbasis::Eigenbasis(int nx, int ny, double dh, const vector<int>& boundary, int count, double shift)
+    : nx(nx), ny(ny), dh(dh), shift(shift), key(hash(nx, ny, dh, boundary, count, shift)) {
+    Eigen::SparseMatrix<double> H = hamiltonian(nx, ny, dh, boundary, cells);
+    int n = static_cast<int>(cells.size());
+    count = min(count, n - 1);
+    if (count < 1) throw runtime_error("eigenbasis: the grid has too few open cells");
+
+    // A clustered spectrum can stall the restarts, so a failed solve is retried with twice
+    // the subspace, up to all of it
+    Eigen::VectorXd values;
+    Eigen::MatrixXd vectors;
+    int ncv = min(n, max(2 * count + 1, 20));
+    Spectra::CompInfo info = solve(H, count, ncv, shift, MAX_ITERATIONS, values, vectors);
+    while (info != Spectra::CompInfo::Successful && ncv < n) {
+        ncv = min(n, 2 * ncv);
+        info = solve(H, count, ncv, shift, MAX_ITERATIONS, values, vectors);
+    }
+    if (info != Spectra::CompInfo::Successful) {
+        throw runtime_error("eigenbasis: Spectra did not converge on " + to_string(count) + " states with " +
+                            to_string(ncv) + " Lanczos vectors");
+    }
+
+    vector<int> order(values.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](int a, int b) { return values[a] < values[b]; });
+    energies.resize(order.size());
+    states.resize(order.size() * static_cast<size_t>(n));
+    for (size_t m = 0; m < order.size(); m++) {
+        energies[m] = values[order[m]];
+        for (int k = 0; k < n; k++) states[m * n + k] = vectors(k, order[m]);
+    }
+}
+
+Eigenbasis Eigenbasis::cached(const string& path, int nx, int ny, double dh, const vector<int>& boundary,
+                              int count, double shift) {
+    uint64_t wanted = hash(nx, ny, dh, boundary, count, shift);
+    try {
+        Eigenbasis basis = load(path);
+        if (basis.key == wanted) return basis;
+    } catch (const runtime_error&) {
+        // Missing or stale: computed below
+    }
+    Eigenbasis basis(nx, ny, dh, boundary, count, shift);
+    basis.save(path);
+    return basis;
+}
+
+uint64_t Eigenbasis::hash(int nx, int ny, double dh, const vector<int>& boundary, int count, double shift) {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&](const void* p, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            h ^= static_cast<const unsigned char*>(p)[i];
+            h *= 1099511628211ull;
+        }
+    };
+    int32_t ints[3] = {nx, ny, count};
+    double doubles[2] = {dh, shift};
+    mix(ints, sizeof(ints));
+    mix(doubles, sizeof(doubles));
+    for (int b : boundary) {
+        char wall = b == 1;
+        mix(&wall, 1);
+    }
+    return h;
+}
+
+// --- Self-check ---
+
+bool Eigenbasis::matchesDense() {
+    // A 12 x 10 grid with a round hole and a notch, about a hundred open cells
+    int nx = 12, ny = 10;
+    double dh = 2;
+    vector<int> boundary(nx * ny, 0);
+    for (int i = 0; i < nx; i++) {
+        for (int j = 0; j < ny; j++) {
+            bool hole = (i - 4) * (i - 4) + (j - 5) * (j - 5) < 4;
+            bool notch = i > 8 && j > 6;
+            boundary[i * ny + j] = hole || notch;
+        }
+    }
+    vector<int> cells;
+    Eigen::SparseMatrix<double> H = hamiltonian(nx, ny, dh, boundary, cells);
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> dense{Eigen::MatrixXd(H)};
+    if (dense.info() != Eigen::Success) return false;
+    const Eigen::VectorXd& exact = dense.eigenvalues(); // ascending
+    double scale = exact[exact.size() - 1];
+
+    // Every state must be an eigenvector, and the energies the dense ones nearest the shift
+    auto agrees = [&](const Eigenbasis& basis, vector<double> wanted) {
+        sort(wanted.begin(), wanted.end());
+        if (basis.getCount() != static_cast<int>(wanted.size())) return false;
+        for (int m = 0; m < basis.getCount(); m++) {
+            if (abs(basis.getEnergy(m) - wanted[m]) > 1e-9 * scale) return false;
+            Eigen::Map<const Eigen::VectorXd> state(basis.states.data() + static_cast<size_t>(m) * basis.getCells(),
+                                                    basis.getCells());
+            if ((H * state - basis.getEnergy(m) * state).norm() > 1e-6 * scale) return false;
+        }
+        return true;
+    };
+    vector<double> lowest(exact.data(), exact.data() + 6);
+    if (!agrees(Eigenbasis(nx, ny, dh, boundary, 6, 0), lowest)) return false;
+
+    double shift = (exact[40] + exact[41]) / 2;
+    vector<double> nearest(exact.data(), exact.data() + exact.size());
+    sort(nearest.begin(), nearest.end(), [&](double a, double b) { return abs(a - shift) < abs(b - shift); });
+    nearest.resize(5);
+    if (!agrees(Eigenbasis(nx, ny, dh, boundary, 5, shift), nearest)) return false;
+
+    // One pass of a subspace barely wider than the states cannot converge, and the solve
+    // has to say so rather than hand back unconverged pairs
+    Eigen::VectorXd values;
+    Eigen::MatrixXd vectors;
+    return solve(H, 8, 9, 0, 1, values, vectors) != Spectra::CompInfo::Successful;
+}
+
+// --- Cache file ---
+
+template <typename T> static void put(ofstream& out, const T* p, size_t n, const string& path) {
+    if (!out.write(reinterpret_cast<const char*>(p), n * sizeof(T))) {
+        throw runtime_error("eigenbasis file: cannot write " + path);
+    }
+}
+template <typename T> static void get(ifstream& in, T* p, size_t n, const string& path) {
+    if (!in.read(reinterpret_cast<char*>(p), n * sizeof(T))) {
+        throw runtime_error("eigenbasis file: truncated " + path);
+    }
+}
+
+Eigenbasis Eigenbasis::load(const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in) throw runtime_error("eigenbasis file: cannot open " + path);
+
+    char magic[sizeof(EigenbasisFormat::MAGIC)];
+    uint32_t version;
+    get(in, magic, sizeof(magic), path);
+    get(in, &version, 1, path);
+    if (memcmp(magic, EigenbasisFormat::MAGIC, sizeof(magic)) != 0) {
+        throw runtime_error("eigenbasis file: bad magic in " + path);
+    }
+    if (version != EigenbasisFormat::VERSION) {
+        throw runtime_error("eigenbasis file: unsupported version in " + path);
+    }
+
+    Eigenbasis basis;
+    int32_t count, cells;
+    get(in, &basis.key, 1, path);
+    get(in, &basis.nx, 1, path);
+    get(in, &basis.ny, 1, path);
+    get(in, &count, 1, path);
+    get(in, &cells, 1, path);
+    get(in, &basis.dh, 1, path);
+    get(in, &basis.shift, 1, path);
+    if (count < 0 || cells < 0 || cells > basis.nx * basis.ny) {
+        throw runtime_error("eigenbasis file: bad sizes in " + path);
+    }
+    basis.cells.resize(cells);
+    basis.energies.resize(count);
+    basis.states.resize(static_cast<size_t>(count) * cells);
+    get(in, basis.cells.data(), basis.cells.size(), path);
+    get(in, basis.energies.data(), basis.energies.size(), path);
+    get(in, basis.states.data(), basis.states.size(), path);
+    return basis;
+}
+
+void Eigenbasis::save(const string& path) const {
+    // Written aside and renamed over path, so a reader never sees half a basis
+    string temporary = path + ".tmp";
+    {
+        ofstream out(temporary, ios::binary);
+        if (!out) throw runtime_error("eigenbasis file: cannot open " + temporary);
+        int32_t sizes[2] = {getCount(), getCells()};
+        put(out, EigenbasisFormat::MAGIC, sizeof(EigenbasisFormat::MAGIC), temporary);
+        put(out, &EigenbasisFormat::VERSION, 1, temporary);
+        put(out, &key, 1, temporary);
+        put(out, &nx, 1, temporary);
+        put(out, &ny, 1, temporary);
+        put(out, sizes, 2, temporary);
+        put(out, &dh, 1, temporary);
+        put(out, &shift, 1, temporary);
+        put(out, cells.data(), cells.size(), temporary);
+        put(out, energies.data(), energies.size(), temporary);
+        put(out, states.data(), states.size(), temporary);
+        out.close();
+        if (!out) throw runtime_error("eigenbasis file: cannot write " + temporary);
+    }
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(temporary.c_str());
+        throw runtime_error("eigenbasis file: cannot rename " + temporary + " to " + path);
+    }
+}
+
+// --- Expansion ---
+
+vector<complex<double>> Eigenbasis::project(const vector<complex<double>>& psi) const {
+    int n = getCells();
+    vector<complex<double>> coefficients(energies.size());
+    for (size_t m = 0; m < energies.size(); m++) {
+        const double* state = states.data() + m * n;
+        double re = 0, im = 0;
+        for (int k = 0; k < n; k++) {
+            re += state[k] * psi[cells[k]].real();
+            im += state[k] * psi[cells[k]].imag();
+        }
+        coefficients[m] = {re, im};
+    }
+    return coefficients;
+}
+
+double Eigenbasis::captured(const vector<complex<double>>& psi, const vector<complex<double>>& coefficients) const {
+    double inside = 0, total = 0;
+    for (const complex<double>& c : coefficients) inside += norm(c);
+    for (int cell : cells) total += norm(psi[cell]);
+    return total > 0 ? inside / total : 0;
+}
+
+void Eigenbasis::evolve(const vector<complex<double>>& coefficients, double t, vector<complex<double>>& psi,
+                        ThreadPool& pool) const {
+    int n = getCells();
+    vector<complex<double>> phased(energies.size());
+    for (size_t m = 0; m < energies.size(); m++) {
+        phased[m] = coefficients[m] * exp(complex<double>(0, energies[m] * t));
+    }
+
+    // Each range of cells sums over the states in its own accumulators, streaming every
+    // state's slice once; cells never mix, so the result is the same for any split
+    pool.parallel_for(n, max(1024, n / (4 * pool.size())), [&](int begin, int end, int) {
+        vector<double> re(end - begin, 0.0), im(end - begin, 0.0);
+        for (size_t m = 0; m < energies.size(); m++) {
+            const double* state = states.data() + m * n + begin;
+            double a = phased[m].real(), b = phased[m].imag();
+            for (int k = 0; k < end - begin; k++) {
+                re[k] += a * state[k];
+                im[k] += b * state[k];
+            }
+        }
+        for (int k = begin; k < end; k++) psi[cells[k]] = {re[k - begin], im[k - begin]};
+    });
+}
+
+void Eigenbasis::evolve(const vector<complex<double>>& coefficients, double t, vector<complex<double>>& psi) const {
+    ThreadPool pool(1);
+    evolve(coefficients, t, psi, pool);
+}
+
+vector<double> Eigenbasis::getState(int n) const {
+    vector<double> grid(static_cast<size_t>(nx) * ny, 0.0);
+    for (int k = 0; k < getCells(); k++) grid[cells[k]] = states[static_cast<size_t>(n) * getCells() + k];
+    return grid;
+}
+
+// Getters
+int Eigenbasis::getNx() const {
+    return nx;
+}
+int Eigenbasis::getNy() const {
+    return ny;
+}
+double Eigenbasis::getDh() const {
+    return dh;
+}
+double Eigenbasis::getShift() const {
+    return shift;
+}
+uint64_t Eigenbasis::getKey() const {
+    return key;
+}
+int Eigenbasis::getCount() const {
+    return static_cast<int>(energies.size());
+}
+int Eigenbasis::getCells() const {
+    return static_cast<int>(cells.size());
+}
+double Eigenbasis::getEnergy(int n) const {
+    return energies[n];
+}
+const vector<double>& Eigenbasis::getEnergies() const {
+    return energies;
+}
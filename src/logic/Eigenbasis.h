@@ -0,0 +1,84 @@
+#ifndef EIGENBASIS_H
+#define EIGENBASIS_H
+
+#include <complex>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class ThreadPool;
+
+// Eigenstates of the quantum billiard, H = -1/2 Lap with the five-point Laplacian on the
+// open cells of a getBoundary mask (walls are Dirichlet). The `count` states with
+// energies nearest `shift` come from Spectra's shift-invert Lanczos solver on the sparse
+// H, so shift = 0 gives the lowest ones and a larger shift picks out states (scars among
+// them) higher in the spectrum. A packet expanded in the basis evolves by a phase per
+// state, so the state at any time t costs one sum over the basis.
+//
+// Cache file layout, native byte order: magic, version, key, nx, ny, count, cells, dh,
+// shift, the grid index of every open cell, the energies, then the states one after
+// another over the open cells.
+namespace EigenbasisFormat {
+    const char MAGIC[8] = {'B', 'I', 'L', 'L', 'E', 'I', 'G', 'N'};
+    const uint32_t VERSION = 1;
+}
+
+class Eigenbasis {
+private:
+    int nx, ny;
+    double dh, shift;
+    uint64_t key;
+    vector<int> cells;          // grid index of each open cell, the basis coordinates
+    vector<double> energies;    // ascending
+    vector<double> states;      // state n is states[n * cells.size() ...], real and orthonormal
+
+    Eigenbasis() = default;
+
+public:
+    // Throws runtime_error if the solver does not converge, even with the Krylov subspace
+    // widened to the whole space
+    Eigenbasis(int nx, int ny, double dh, const vector<int>& boundary, int count, double shift = 0);
+
+    // Reads the basis for these inputs from path if it is there, else computes it and
+    // writes it there
+    static Eigenbasis cached(const string& path, int nx, int ny, double dh, const vector<int>& boundary,
+                             int count, double shift = 0);
+    // Hash of everything the basis depends on, boundary included (64-bit FNV-1a)
+    static uint64_t hash(int nx, int ny, double dh, const vector<int>& boundary, int count, double shift);
+
+    static Eigenbasis load(const string& path);
+    // Writes to path + ".tmp" and renames it over path; throws runtime_error on failure
+    void save(const string& path) const;
+
+    // Solves a small irregular grid and checks the lowest states and some nearest a shift
+    // against a dense eigensolver, and that a solve too cramped to converge is reported
+    static bool matchesDense();
+
+    // Expansion coefficients of psi (nx * ny, x-major); its wall cells are ignored
+    vector<complex<double>> project(const vector<complex<double>>& psi) const;
+    // Share of |psi|^2 the basis captures, 1 for a packet made of the computed states only
+    double captured(const vector<complex<double>>& psi, const vector<complex<double>>& coefficients) const;
+    // The expanded state at time t, with the sign of time RK4_Schrodinger uses, into the
+    // open cells of psi; wall cells are left as they are
+    void evolve(const vector<complex<double>>& coefficients, double t, vector<complex<double>>& psi) const;
+    void evolve(const vector<complex<double>>& coefficients, double t, vector<complex<double>>& psi,
+                ThreadPool& pool) const;
+
+    // State n on the full grid, zero on walls
+    vector<double> getState(int n) const;
+
+    // Getters
+    int getNx() const;
+    int getNy() const;
+    double getDh() const;
+    double getShift() const;
+    uint64_t getKey() const;
+    int getCount() const;
+    int getCells() const;
+    double getEnergy(int n) const;
+    const vector<double>& getEnergies() const;
+};
+
+#endif //EIGENBASIS_H
@@ -0,0 +1,286 @@
+#include "Ensemble.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+static const double EPS_T = 1e-9;     // minimum flight length accepted as a hit
+static const double EPS_SEAM = 1e-9;  // overlap at arc/segment seams
+
+Ensemble::Ensemble(const SinaiBilliard& billiard) : billiard(billiard) {
+    const Billiard& outer = billiard.getOuter();
+    const vector<Edge>& edges = outer.getEdges();
+    int surfaces = outer.getSurfaces() + static_cast<int>(billiard.getScatterers().size());
+    for (vector<double>* v : {&nkx, &nky, &ncx, &ncy, &nox, &noy}) v->assign(surfaces, 0.0);
+
+    // --- Outer boundary, degenerate edges dropped ---
+    for (int i = 0; i < static_cast<int>(edges.size()); i++) {
+        const Edge& e = edges[i];
+        if (e.degenerate()) continue;
+
+        if (!e.arc) {
+            sqx.push_back(e.p0.x); sqy.push_back(e.p0.y);
+            sux.push_back(e.p1.x - e.p0.x); suy.push_back(e.p1.y - e.p0.y);
+            sid.push_back(i);
+            Vec2 n = outer.getNormal(i, e.p0);
+            nox[i] = n.x;
+            noy[i] = n.y;
+            continue;
+        }
+
+        double from = e.sweep > 0 ? e.start : e.start + e.sweep;
+        double to = from + abs(e.sweep);
+        acx.push_back(e.center.x); acy.push_back(e.center.y);
+        arx2.push_back(e.rx * e.rx); ary2.push_back(e.ry * e.ry);
+        arx2ry2.push_back(e.rx * e.rx * e.ry * e.ry);
+        airx.push_back(1 / e.rx); airy.push_back(1 / e.ry);
+        afx.push_back(cos(from)); afy.push_back(sin(from));
+        atx.push_back(cos(to)); aty.push_back(sin(to));
+        awide.push_back(abs(e.sweep) > M_PI ? 1 : 0);
+        aid.push_back(i);
+        // Gradient of the ellipse, flipped on clockwise arcs so it points out of the table
+        double orientation = e.sweep > 0 ? 1 : -1;
+        nkx[i] = orientation * e.ry * e.ry;
+        nky[i] = orientation * e.rx * e.rx;
+        ncx[i] = e.center.x;
+        ncy[i] = e.center.y;
+    }
+
+    a2 = outer.getA() * outer.getA();
+    b2 = outer.getB() * outer.getB();
+    a2b2 = a2 * b2;
+    Billiard::Shape shape = outer.getShape();
+    conic = shape == Billiard::CIRCLE || shape == Billiard::ELLIPSE;
+
+    // --- Scatterers ---
+    grid = billiard.getGrid();
+    int id = outer.getSurfaces();
+    for (const auto& c : billiard.getScatterers()) {
+        ccx.push_back(c.center.x);
+        ccy.push_back(c.center.y);
+        cr2.push_back(c.radius * c.radius);
+        nkx[id] = nky[id] = 1;
+        ncx[id] = c.center.x;
+        ncy[id] = c.center.y;
+        id++;
+    }
+}
+
+void Ensemble::add(Vec2 p, Vec2 d, int from) {
+    d = d.normalize();
+    px.push_back(p.x);
+    py.push_back(p.y);
+    dx.push_back(d.x);
+    dy.push_back(d.y);
+    surface.push_back(from);
+    flight.push_back(0);
+}
+
+int Ensemble::size() const {
+    return static_cast<int>(px.size());
+}
+
+void Ensemble::intersectBlock(int begin, int end, double* t_best, int* s_best) const {
+    const int n = end - begin;
+    const double* PX = px.data() + begin;
+    const double* PY = py.data() + begin;
+    const double* DX = dx.data() + begin;
+    const double* DY = dy.data() + begin;
+    const int* S = surface.data() + begin;
+
+    for (int j = 0; j < n; j++) {
+        t_best[j] = numeric_limits<double>::infinity();
+        s_best[j] = -1;
+    }
+
+    if (conic) {
+        // --- Whole ellipse centred at the origin: one root, the quadrant names the arc ---
+        for (int j = 0; j < n; j++) {
+            double A = b2 * DX[j] * DX[j] + a2 * DY[j] * DY[j];
+            double B = 2 * (b2 * DX[j] * PX[j] + a2 * DY[j] * PY[j]);
+            double C = b2 * PX[j] * PX[j] + a2 * PY[j] * PY[j] - a2b2;
+            double disc = B * B - 4 * A * C;
+            double t = (-B + sqrt(disc > 0 ? disc : 0)) / (2 * A);
+            double hx = PX[j] + DX[j] * t;
+            double hy = PY[j] + DY[j] * t;
+            int id = hy >= 0 ? (hx < 0 ? Billiard::TOP_LEFT : Billiard::TOP_RIGHT)
+                             : (hx < 0 ? Billiard::BOTTOM_LEFT : Billiard::BOTTOM_RIGHT);
+            bool hit = disc >= 0 && t > EPS_T;
+            t_best[j] = hit ? t : t_best[j];
+            s_best[j] = hit ? id : s_best[j];
+        }
+    } else {
+        // --- Segments ---
+        for (size_t k = 0; k < sqx.size(); k++) {
+            const double qx = sqx[k], qy = sqy[k], ux = sux[k], uy = suy[k];
+            const int id = sid[k];
+            for (int j = 0; j < n; j++) {
+                double cross = DX[j] * uy - DY[j] * ux;
+                double subx = qx - PX[j];
+                double suby = qy - PY[j];
+                double t = (subx * uy - suby * ux) / cross;
+                double s = (subx * DY[j] - suby * DX[j]) / cross;
+                bool hit = fabs(cross) > 1e-12 && t > EPS_T && t < t_best[j]
+                           && s >= -EPS_SEAM && s <= 1 + EPS_SEAM;
+                t_best[j] = hit ? t : t_best[j];
+                s_best[j] = hit ? id : s_best[j];
+            }
+        }
+
+        // --- Arcs: the ray may enter or leave an arc's ellipse on the arc, so both roots are tried ---
+        for (size_t k = 0; k < acx.size(); k++) {
+            const double cx = acx[k], cy = acy[k], A2 = ary2[k], B2 = arx2[k], AB2 = arx2ry2[k];
+            const double irx = airx[k], iry = airy[k];
+            const double fx0 = afx[k], fy0 = afy[k], tx0 = atx[k], ty0 = aty[k];
+            const bool wide = awide[k] != 0;
+            const int id = aid[k];
+            for (int j = 0; j < n; j++) {
+                double fx = PX[j] - cx;
+                double fy = PY[j] - cy;
+                double A = A2 * DX[j] * DX[j] + B2 * DY[j] * DY[j];
+                double B = 2 * (A2 * DX[j] * fx + B2 * DY[j] * fy);
+                double C = A2 * fx * fx + B2 * fy * fy - AB2;
+                double disc = B * B - 4 * A * C;
+                double sq = sqrt(disc > 0 ? disc : 0);
+                double t1 = (-B - sq) / (2 * A);
+                double t2 = (-B + sq) / (2 * A);
+
+                // Unit-circle coordinates of both candidates, tested against the angular range
+                double u1 = (fx + DX[j] * t1) * irx, v1 = (fy + DY[j] * t1) * iry;
+                double u2 = (fx + DX[j] * t2) * irx, v2 = (fy + DY[j] * t2) * iry;
+                double c11 = fx0 * v1 - fy0 * u1, c12 = u1 * ty0 - v1 * tx0;
+                double c21 = fx0 * v2 - fy0 * u2, c22 = u2 * ty0 - v2 * tx0;
+                bool in1 = wide ? !(c11 < -EPS_SEAM && c12 < -EPS_SEAM) : (c11 >= -EPS_SEAM && c12 >= -EPS_SEAM);
+                bool in2 = wide ? !(c21 < -EPS_SEAM && c22 < -EPS_SEAM) : (c21 >= -EPS_SEAM && c22 >= -EPS_SEAM);
+
+                bool ok1 = disc >= 0 && t1 > EPS_T && in1;
+                bool ok2 = disc >= 0 && t2 > EPS_T && in2;
+                double t = ok1 ? t1 : t2;
+                bool hit = (ok1 || ok2) && t < t_best[j];
+                t_best[j] = hit ? t : t_best[j];
+                s_best[j] = hit ? id : s_best[j];
+            }
+        }
+    }
+
+    // --- Scatterers: many of them are walked through the grid, one particle at a time ---
+    if (grid->active()) {
+        const int base = billiard.getOuter().getSurfaces();
+        for (int j = 0; j < n; j++) {
+            double t;
+            int k = grid->intersect(billiard.getScatterers(), {PX[j], PY[j]}, {DX[j], DY[j]}, t_best[j], S[j] - base, t);
+            if (k >= 0) {
+                t_best[j] = t;
+                s_best[j] = base + k;
+            }
+        }
+        return;
+    }
+
+    // --- Scatterers: particles are outside every scatterer, so the near root is the hit ---
+    const int base = billiard.getOuter().getSurfaces();
+    for (size_t k = 0; k < ccx.size(); k++) {
+        const double cx = ccx[k], cy = ccy[k], r2 = cr2[k];
+        const int id = base + static_cast<int>(k);
+        for (int j = 0; j < n; j++) {
+            double fx = PX[j] - cx;
+            double fy = PY[j] - cy;
+            double B = fx * DX[j] + fy * DY[j];
+            double C = fx * fx + fy * fy - r2;
+            double disc = B * B - C;
+            double t = -B - sqrt(disc > 0 ? disc : 0);
+            bool hit = disc >= 0 && S[j] != id && t > EPS_T && t < t_best[j];
+            t_best[j] = hit ? t : t_best[j];
+            s_best[j] = hit ? id : s_best[j];
+        }
+    }
+}
+
+void Ensemble::reflectBlock(int begin, int end, const double* t_best, const int* s_best) {
+    const int n = end - begin;
+    double* PX = px.data() + begin;
+    double* PY = py.data() + begin;
+    double* DX = dx.data() + begin;
+    double* DY = dy.data() + begin;
+    int* S = surface.data() + begin;
+    double* F = flight.data() + begin;
+    const double* KX = nkx.data();
+    const double* KY = nky.data();
+    const double* CX = ncx.data();
+    const double* CY = ncy.data();
+    const double* OX = nox.data();
+    const double* OY = noy.data();
+
+    for (int j = 0; j < n; j++) {
+        int s = s_best[j];
+        F[j] = s < 0 ? 0 : t_best[j];
+        if (s < 0) continue; // no boundary ahead, leave the particle where it is
+
+        double x = PX[j] + DX[j] * t_best[j];
+        double y = PY[j] + DY[j] * t_best[j];
+        double nx = KX[s] * (x - CX[s]) + OX[s];
+        double ny = KY[s] * (y - CY[s]) + OY[s];
+        double inv = 1.0 / sqrt(nx * nx + ny * ny);
+        nx *= inv;
+        ny *= inv;
+
+        double dot = DX[j] * nx + DY[j] * ny;
+        PX[j] = x;
+        PY[j] = y;
+        DX[j] -= 2 * dot * nx;
+        DY[j] -= 2 * dot * ny;
+        S[j] = s;
+    }
+}
+
+void Ensemble::step() {
+    double t_best[BLOCK];
+    int s_best[BLOCK];
+
+    for (int begin = 0; begin < size(); begin += BLOCK) {
+        int end = min(begin + BLOCK, size());
+        intersectBlock(begin, end, t_best, s_best);
+        reflectBlock(begin, end, t_best, s_best);
+    }
+}
+
+int Ensemble::compact(const vector<char>& keep) {
+    int n = 0;
+    for (int i = 0; i < size(); i++) {
+        if (!keep[i]) continue;
+        px[n] = px[i]; py[n] = py[i];
+        dx[n] = dx[i]; dy[n] = dy[i];
+        surface[n] = surface[i];
+        flight[n] = flight[i];
+        n++;
+    }
+    px.resize(n); py.resize(n);
+    dx.resize(n); dy.resize(n);
+    surface.resize(n);
+    flight.resize(n);
+    return n;
+}
+
+// Getters
+const SinaiBilliard& Ensemble::getBilliard() const {
+    return billiard;
+}
+Vec2 Ensemble::getPosition(int i) const {
+    return {px[i], py[i]};
+}
+Vec2 Ensemble::getDirection(int i) const {
+    return {dx[i], dy[i]};
+}
+int Ensemble::getSurface(int i) const {
+    return surface[i];
+}
+double Ensemble::getFlight(int i) const {
+    return flight[i];
+}
+const vector<double>& Ensemble::getX() const {
+    return px;
+}
+const vector<double>& Ensemble::getY() const {
+    return py;
+}
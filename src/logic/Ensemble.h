@@ -0,0 +1,71 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <memory>
+#include <vector>
+#include "Vec2.h"
+#include "SinaiBilliard.h"
+
+using namespace std;
+
+// Structure-of-arrays particle ensemble.
+// Positions and directions live in separate contiguous x/y arrays and every
+// bounce is computed for a whole block of particles at once, one boundary
+// primitive at a time, so the inner loops are branch-free and vectorise.
+class Ensemble {
+private:
+    // Particle state
+    vector<double> px, py;   // positions
+    vector<double> dx, dy;   // unit directions
+    vector<int> surface;     // SinaiBilliard surface id of the last bounce (-1 = none yet)
+    vector<double> flight;   // length of the last free flight (0 = no boundary ahead)
+
+    const SinaiBilliard& billiard; // not owned, must outlive the ensemble
+
+    // Outer boundary: flat segments q + k * u, k in [0, 1]
+    vector<double> sqx, sqy, sux, suy;
+    vector<int> sid;
+    // Outer boundary: elliptic arcs ry^2 x^2 + rx^2 y^2 = rx^2 ry^2 about (cx, cy),
+    // limited to the counter-clockwise range from (fx, fy) to (tx, ty) on the unit circle
+    vector<double> acx, acy, arx2, ary2, arx2ry2, airx, airy, afx, afy, atx, aty, awide;
+    vector<int> aid;
+    // Whole ellipse about the origin when l == h == 0
+    bool conic;
+    double a2, b2, a2b2;
+    // Scatterers: flat tables for the vectorised scan, the grid once there are many of them
+    vector<double> ccx, ccy, cr2;
+    shared_ptr<const ScattererGrid> grid;
+    // Normal of surface s at (x, y), before normalising: (nkx (x - ncx) + nox, nky (y - ncy) + noy).
+    // Segments only have the constant part, arcs and scatterers only the radial one.
+    vector<double> nkx, nky, ncx, ncy, nox, noy;
+
+    void intersectBlock(int begin, int end, double* t_best, int* s_best) const;
+    void reflectBlock(int begin, int end, const double* t_best, const int* s_best);
+
+public:
+    static const int BLOCK = 64;
+
+    // billiard is held by reference, not copied
+    explicit Ensemble(const SinaiBilliard& billiard);
+
+    void add(Vec2 p, Vec2 d, int surface = -1); // surface: the one p lies on, if any
+    int size() const;
+
+    // Advance every particle to its next collision and reflect it
+    void step();
+
+    // Drops every particle i with keep[i] == 0, keeping the others in order, so blocks
+    // stay full once particles are retired; returns the new size
+    int compact(const vector<char>& keep);
+
+    // Getters
+    const SinaiBilliard& getBilliard() const;
+    Vec2 getPosition(int i) const;
+    Vec2 getDirection(int i) const;
+    int getSurface(int i) const;
+    double getFlight(int i) const;
+    const vector<double>& getX() const;
+    const vector<double>& getY() const;
+};
+
+#endif //ENSEMBLE_H
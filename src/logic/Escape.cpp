@@ -0,0 +1,146 @@
+#include "Escape.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+Hole Hole::whole(int surface) {
+    Hole hole;
+    hole.surface = surface;
+    return hole;
+}
+
+Hole Hole::interval(double from, double to) {
+    Hole hole;
+    hole.from = from;
+    hole.to = to;
+    return hole;
+}
+
+Escape::Escape(const SinaiBilliard& billiard, double compactFraction)
+    : ensemble(billiard), active(0), bounces(0), compactions(0), compactFraction(compactFraction) {
+    holeSurface.assign(billiard.getOuter().getSurfaces() + billiard.getScatterers().size(), 0);
+}
+
+void Escape::addHole(const Hole& hole) {
+    holes.push_back(hole);
+    if (hole.surface >= 0 && hole.surface < static_cast<int>(holeSurface.size())) {
+        holeSurface[hole.surface] = 1;
+    }
+}
+
+void Escape::add(Vec2 p, Vec2 d, int surface) {
+    ensemble.add(p, d, surface);
+    ids.push_back(size());
+    time.push_back(0);
+    alive.push_back(1);
+    active++;
+    escapeTime.push_back(numeric_limits<double>::infinity());
+    escapeBounce.push_back(-1);
+}
+
+int Escape::size() const {
+    return static_cast<int>(escapeTime.size());
+}
+
+bool Escape::inHole(int surface, Vec2 p) const {
+    if (holeSurface[surface]) return true;
+
+    double s = -1;
+    for (const Hole& hole : holes) {
+        if (hole.surface >= 0) continue;
+        if (s < 0) s = ensemble.getBilliard().getArcLength(surface, p);
+        bool in = hole.from <= hole.to ? s >= hole.from && s < hole.to : s >= hole.from || s < hole.to;
+        if (in) return true;
+    }
+    return false;
+}
+
+void Escape::step() {
+    if (active == 0) return;
+    ensemble.step();
+    bounces++;
+
+    for (int k = 0; k < ensemble.size(); k++) {
+        int s = ensemble.getSurface(k);
+        if (!alive[k] || ensemble.getFlight(k) == 0) continue;
+
+        time[k] += ensemble.getFlight(k);
+        if (inHole(s, ensemble.getPosition(k))) {
+            escapeTime[ids[k]] = time[k];
+            escapeBounce[ids[k]] = bounces;
+            alive[k] = 0;
+            active--;
+        }
+    }
+
+    if (ensemble.size() - active >= max(1.0, compactFraction * ensemble.size())) compact();
+}
+
+void Escape::compact() {
+    ensemble.compact(alive);
+    int n = 0;
+    for (size_t k = 0; k < alive.size(); k++) {
+        if (!alive[k]) continue;
+        ids[n] = ids[k];
+        time[n] = time[k];
+        n++;
+    }
+    ids.resize(n);
+    time.resize(n);
+    alive.assign(n, 1);
+    compactions++;
+}
+
+vector<double> Escape::survival(const vector<double>& times, int total, double t_max, int bins) {
+    vector<double> sorted(times);
+    sort(sorted.begin(), sorted.end());
+
+    vector<double> p(bins + 1);
+    for (int k = 0; k <= bins; k++) {
+        double t = t_max * k / bins;
+        size_t gone = upper_bound(sorted.begin(), sorted.end(), t) - sorted.begin();
+        p[k] = total > 0 ? static_cast<double>(total - gone) / total : 0;
+    }
+    return p;
+}
+
+vector<uint64_t> Escape::histogram(const vector<double>& times, double t_max, int bins) {
+    vector<uint64_t> counts(bins, 0);
+    for (double t : times) {
+        if (!(t >= 0 && t < t_max)) continue;
+        counts[min(bins - 1, static_cast<int>(t / t_max * bins))]++;
+    }
+    return counts;
+}
+
+// Getters
+const vector<Hole>& Escape::getHoles() const {
+    return holes;
+}
+int Escape::getActive() const {
+    return active;
+}
+long long Escape::getBounces() const {
+    return bounces;
+}
+long long Escape::getCompactions() const {
+    return compactions;
+}
+double Escape::getEscapeTime(int i) const {
+    return escapeTime[i];
+}
+long long Escape::getEscapeBounce(int i) const {
+    return escapeBounce[i];
+}
+const vector<double>& Escape::getEscapeTimes() const {
+    return escapeTime;
+}
+double Escape::getHorizon() const {
+    double horizon = numeric_limits<double>::infinity();
+    for (size_t k = 0; k < time.size(); k++) {
+        if (alive[k]) horizon = min(horizon, time[k]);
+    }
+    return horizon;
+}
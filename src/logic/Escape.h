@@ -0,0 +1,76 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include <cstdint>
+#include <vector>
+#include "Vec2.h"
+#include "Ensemble.h"
+
+using namespace std;
+
+// A hole in the boundary: a whole surface (an edge or a scatterer), or an interval of
+// Birkhoff arc length s that may run through s = 0
+struct Hole {
+    int surface = -1;         // whole surface, -1 for an interval
+    double from = 0, to = 0;  // arc length interval [from, to), wraps when from > to
+
+    static Hole whole(int surface);
+    static Hole interval(double from, double to);
+};
+
+// Open billiard: particles that land on a hole leave the table. The engine keeps the
+// escape time (path length, the particles move at unit speed) and bounce of everyone
+// who left and retires them from the ensemble. Retired particles keep their slot until
+// enough of them pile up, then the ensemble is compacted so blocks stay full.
+class Escape {
+private:
+    Ensemble ensemble;
+    vector<Hole> holes;
+    vector<char> holeSurface;    // surface id -> whole surface is a hole
+
+    // Per ensemble slot, compacted along with it
+    vector<int> ids;             // particle index
+    vector<double> time;         // path length so far
+    vector<char> alive;
+    int active;
+
+    // Per particle
+    vector<double> escapeTime;   // infinity while inside
+    vector<long long> escapeBounce; // -1 while inside
+
+    long long bounces, compactions;
+    double compactFraction;
+
+    bool inHole(int surface, Vec2 p) const;
+    void compact();
+
+public:
+    static constexpr double COMPACT = 0.25; // fraction of retired slots that triggers a compaction
+
+    // billiard is held by reference and must outlive the engine
+    explicit Escape(const SinaiBilliard& billiard, double compactFraction = COMPACT);
+
+    void addHole(const Hole& hole);
+    void add(Vec2 p, Vec2 d, int surface = -1);
+    int size() const;
+
+    // Advance every particle still inside by one bounce
+    void step();
+
+    // Getters
+    const vector<Hole>& getHoles() const;
+    int getActive() const;
+    long long getBounces() const;
+    long long getCompactions() const;
+    double getEscapeTime(int i) const;      // infinity if particle i is still inside
+    long long getEscapeBounce(int i) const; // -1 if particle i is still inside
+    const vector<double>& getEscapeTimes() const;
+    double getHorizon() const; // shortest path length reached by a particle still inside
+
+    // Fraction of `total` particles with escape time > t_k, t_k = k * t_max / bins, k = 0..bins
+    static vector<double> survival(const vector<double>& times, int total, double t_max, int bins);
+    // Escape times binned over [0, t_max); later ones are dropped
+    static vector<uint64_t> histogram(const vector<double>& times, double t_max, int bins);
+};
+
+#endif //ESCAPE_H
@@ -0,0 +1,336 @@
+#include "HardDiskGas.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+static const double INF = numeric_limits<double>::infinity();
+
+// --- Wall table ---
+
+// Outward normal of an edge at its first or last point
+static Vec2 edgeNormal(const Edge& e, bool end) {
+    if (!e.arc) {
+        Vec2 u = e.p1 - e.p0;
+        return Vec2(u.y, -u.x).normalize();
+    }
+    double th = end ? e.start + e.sweep : e.start;
+    return Vec2(e.ry * cos(th), e.rx * sin(th)).normalize() * (e.sweep > 0 ? 1 : -1);
+}
+
+// Where two shifted edges cross nearest the corner v they used to share. Arc-arc corners
+// are not handled and keep their overlapping ends.
+static bool crossing(const Edge& e, const Edge& f, Vec2 v, Vec2& x) {
+    if (e.arc && f.arc) return false;
+    if (!e.arc && !f.arc) {
+        Vec2 u = e.p1 - e.p0, w = f.p1 - f.p0;
+        double cross = u * w;
+        if (abs(cross) < 1e-12) return false;
+        x = e.p0 + u * (((f.p0 - e.p0) * w) / cross);
+        return true;
+    }
+
+    // The segment's line against the arc's ellipse
+    const Edge& s = e.arc ? f : e;
+    const Edge& a = e.arc ? e : f;
+    Vec2 u = s.p1 - s.p0;
+    double px = (s.p0.x - a.center.x) / a.rx, py = (s.p0.y - a.center.y) / a.ry;
+    double ux = u.x / a.rx, uy = u.y / a.ry;
+    double A = ux * ux + uy * uy, B = 2 * (px * ux + py * uy), C = px * px + py * py - 1;
+    double disc = B * B - 4 * A * C;
+    if (disc < 0) return false;
+    Vec2 x1 = s.p0 + u * ((-B - sqrt(disc)) / (2 * A));
+    Vec2 x2 = s.p0 + u * ((-B + sqrt(disc)) / (2 * A));
+    x = (x1 - v).mag() < (x2 - v).mag() ? x1 : x2;
+    return true;
+}
+
+// Shortens an edge so it ends (or starts) at x, a point on it
+static void trim(Edge& e, Vec2 x, bool end) {
+    if (!e.arc) {
+        (end ? e.p1 : e.p0) = x;
+        return;
+    }
+    double th = atan2((x.y - e.center.y) / e.ry, (x.x - e.center.x) / e.rx);
+    double from = end ? e.start : e.start + e.sweep;
+    double d = fmod((e.sweep > 0) == end ? th - from : from - th, 2 * M_PI);
+    if (d < 0) d += 2 * M_PI;
+    if (d >= abs(e.sweep)) return;
+    double sweep = e.sweep > 0 ? d : -d;
+    e = end ? Edge::ellipticArc(e.center, e.rx, e.ry, e.start, sweep)
+            : Edge::ellipticArc(e.center, e.rx, e.ry, from - sweep, sweep);
+}
+
+SinaiBilliard HardDiskGas::inset(const SinaiBilliard& billiard, double radius) {
+    const Billiard& outer = billiard.getOuter();
+    SinaiBilliard walls(0, 0, 0, 0);
+
+    if (outer.getShape() != Billiard::EDGES) {
+        // Flat sections move in by r and arc radii shrink by r: exact for circular arcs,
+        // a close approximation to the true offset curve of an elliptic one
+        double a = outer.getA(), b = outer.getB(), l = outer.getL(), h = outer.getH();
+        if (a > 0) a -= radius; else l -= radius;
+        if (b > 0) b -= radius; else h -= radius;
+        walls = SinaiBilliard(a, b, l, h);
+    } else {
+        // Every edge moves in along its normal. Where the boundary turns counter-clockwise
+        // the shifted edges overlap and are trimmed back to their crossing; where it turns
+        // clockwise (a reflex corner) they leave a gap, closed by an arc of radius r about
+        // the corner. The edges must form one closed counter-clockwise chain.
+        vector<Edge> edges;
+        for (const Edge& e : outer.getEdges()) {
+            if (!e.degenerate()) edges.push_back(e);
+        }
+        size_t n = edges.size();
+        vector<Edge> shifted;
+        for (const Edge& e : edges) {
+            if (e.arc) {
+                double s = e.sweep > 0 ? radius : -radius;
+                shifted.push_back(Edge::ellipticArc(e.center, e.rx - s, e.ry - s, e.start, e.sweep));
+            } else {
+                Vec2 nrm = edgeNormal(e, false) * radius;
+                shifted.push_back(Edge::segment(e.p0 - nrm, e.p1 - nrm));
+            }
+        }
+
+        vector<Edge> joints(n);
+        for (size_t k = 0; k < n; k++) {
+            size_t next = (k + 1) % n;
+            Vec2 n0 = edgeNormal(edges[k], true), n1 = edgeNormal(edges[next], false);
+            double turn = n0 * n1;
+            Vec2 x;
+            if (turn > 1e-12 && crossing(shifted[k], shifted[next], edges[k].p1, x)) {
+                trim(shifted[k], x, true);
+                trim(shifted[next], x, false);
+            } else if (turn < -1e-12) {
+                double from = atan2(-n0.y, -n0.x);
+                double sweep = atan2(-n1.y, -n1.x) - from;
+                while (sweep > 0) sweep -= 2 * M_PI;
+                joints[k] = Edge::ellipticArc(edges[k].p1, radius, radius, from, sweep);
+            }
+        }
+
+        vector<Edge> chain;
+        for (size_t k = 0; k < n; k++) {
+            chain.push_back(shifted[k]);
+            if (!joints[k].degenerate()) chain.push_back(joints[k]);
+        }
+        walls = SinaiBilliard(Billiard(chain));
+    }
+
+    vector<Circle> inflated;
+    for (const Circle& c : billiard.getScatterers()) inflated.push_back({c.center, c.radius + radius});
+    walls.addScatterers(inflated);
+    return walls;
+}
+
+// --- Construction ---
+
+HardDiskGas::HardDiskGas(const SinaiBilliard& billiard, double radius)
+    : walls(inset(billiard, radius)), radius(radius), now(0), started(false),
+      disk_collisions(0), wall_collisions(0) {
+    Vec2 lo = walls.getOuter().getLower();
+    Vec2 hi = walls.getOuter().getUpper();
+    x0 = lo.x;
+    y0 = lo.y;
+
+    // Roughly square cells, never narrower than a diameter, at most 2048 per axis
+    double width = max(hi.x - lo.x, 1e-9), height = max(hi.y - lo.y, 1e-9);
+    cell = max(2 * radius, max(width, height) / 2048);
+    nx = max(1, static_cast<int>(width / cell));
+    ny = max(1, static_cast<int>(height / cell));
+    cell = max(width / nx, height / ny);
+    cells.assign(static_cast<size_t>(nx) * ny, vector<int>());
+}
+
+bool HardDiskGas::add(Vec2 p, Vec2 v) {
+    if (!walls.contains(p)) return false;
+
+    int cx = min(nx - 1, max(0, static_cast<int>((p.x - x0) / cell)));
+    int cy = min(ny - 1, max(0, static_cast<int>((p.y - y0) / cell)));
+    for (int j = max(0, cy - 1); j <= min(ny - 1, cy + 1); j++) {
+        for (int k = max(0, cx - 1); k <= min(nx - 1, cx + 1); k++) {
+            for (int other : cells[j * nx + k]) {
+                if ((getPosition(other) - p).mag() < 2 * radius) return false;
+            }
+        }
+    }
+
+    disks.push_back({p.x, p.y, v.x, v.y, now, 0, cx, cy, -1});
+    int i = size() - 1;
+    insertCell(i);
+    if (started) predict(i, -1);
+    return true;
+}
+
+int HardDiskGas::size() const {
+    return static_cast<int>(disks.size());
+}
+
+// --- Cell list ---
+
+void HardDiskGas::insertCell(int i) {
+    cells[disks[i].cy * nx + disks[i].cx].push_back(i);
+}
+
+void HardDiskGas::eraseCell(int i) {
+    vector<int>& c = cells[disks[i].cy * nx + disks[i].cx];
+    auto it = find(c.begin(), c.end(), i);
+    *it = c.back();
+    c.pop_back();
+}
+
+// --- Prediction ---
+
+void HardDiskGas::move(int i, double t) {
+    Disk& d = disks[i];
+    d.x += d.vx * (t - d.t);
+    d.y += d.vy * (t - d.t);
+    d.t = t;
+}
+
+void HardDiskGas::predictCell(int i) {
+    const Disk& d = disks[i];
+    double tx = INF, ty = INF;
+    int cx = d.cx, cy = d.cy;
+    if (d.vx > 0 && d.cx + 1 < nx) tx = (x0 + (d.cx + 1) * cell - d.x) / d.vx;
+    if (d.vx < 0 && d.cx > 0) tx = (x0 + d.cx * cell - d.x) / d.vx;
+    if (d.vy > 0 && d.cy + 1 < ny) ty = (y0 + (d.cy + 1) * cell - d.y) / d.vy;
+    if (d.vy < 0 && d.cy > 0) ty = (y0 + d.cy * cell - d.y) / d.vy;
+    if (tx == INF && ty == INF) return;
+
+    if (tx < ty) cx += d.vx > 0 ? 1 : -1;
+    else cy += d.vy > 0 ? 1 : -1;
+    events.push({d.t + max(0.0, min(tx, ty)), i, cy * nx + cx, d.count, 0, CELL});
+}
+
+// All events of disk i, leaving out partner `skip` (just collided with it)
+void HardDiskGas::predict(int i, int skip) {
+    predictWall(i);
+    predictDisks(i, skip);
+    predictCell(i);
+}
+
+void HardDiskGas::predictWall(int i) {
+    // A point in the wall table, distances along the unit direction
+    const Disk& d = disks[i];
+    double speed = sqrt(d.vx * d.vx + d.vy * d.vy);
+    if (speed == 0) return;
+    Hit hit = walls.intersect({d.x, d.y}, {d.vx / speed, d.vy / speed}, d.surface);
+    if (hit.surface >= 0) {
+        events.push({d.t + hit.t / speed, i, hit.surface, d.count, 0, WALL});
+    }
+}
+
+void HardDiskGas::predictDisks(int i, int skip) {
+    const Disk& d = disks[i];
+    const double sigma2 = 4 * radius * radius;
+    for (int cy = max(0, d.cy - 1); cy <= min(ny - 1, d.cy + 1); cy++) {
+        for (int cx = max(0, d.cx - 1); cx <= min(nx - 1, d.cx + 1); cx++) {
+            for (int j : cells[cy * nx + cx]) {
+                if (j == i || j == skip) continue;
+                const Disk& e = disks[j];
+                // Relative motion, both disks taken to d.t
+                double rx = e.x + e.vx * (d.t - e.t) - d.x;
+                double ry = e.y + e.vy * (d.t - e.t) - d.y;
+                double ux = e.vx - d.vx, uy = e.vy - d.vy;
+                double b = rx * ux + ry * uy;
+                if (b >= 0) continue; // moving apart
+                double uu = ux * ux + uy * uy;
+                double disc = b * b - uu * (rx * rx + ry * ry - sigma2);
+                if (disc < 0) continue;
+                double t = -(b + sqrt(disc)) / uu;
+                events.push({d.t + max(0.0, t), i, j, d.count, e.count, DISK});
+            }
+        }
+    }
+}
+
+// --- Event loop ---
+
+void HardDiskGas::advance(double t_end) {
+    if (!started) {
+        started = true;
+        for (int i = 0; i < size(); i++) predict(i, -1);
+    }
+
+    while (!events.empty() && events.top().t <= t_end) {
+        Event ev = events.top();
+        events.pop();
+        Disk& a = disks[ev.i];
+        if (a.count != ev.count_i) continue;
+        now = ev.t;
+
+        if (ev.kind == CELL) {
+            move(ev.i, now);
+            eraseCell(ev.i);
+            a.cx = ev.j % nx;
+            a.cy = ev.j / nx;
+            insertCell(ev.i);
+            // New neighbours; the wall event already queued for the disk stays valid
+            predictDisks(ev.i, -1);
+            predictCell(ev.i);
+            continue;
+        }
+
+        if (ev.kind == WALL) {
+            move(ev.i, now);
+            Vec2 n = walls.getNormal(ev.j, {a.x, a.y});
+            double dot = a.vx * n.x + a.vy * n.y;
+            a.vx -= 2 * dot * n.x;
+            a.vy -= 2 * dot * n.y;
+            a.surface = ev.j;
+            a.count++;
+            wall_collisions++;
+            predict(ev.i, -1);
+            continue;
+        }
+
+        Disk& b = disks[ev.j];
+        if (b.count != ev.count_j) continue;
+        move(ev.i, now);
+        move(ev.j, now);
+
+        // Equal masses: exchange the velocity components along the line of centres
+        double nx_ = (b.x - a.x) / (2 * radius), ny_ = (b.y - a.y) / (2 * radius);
+        double dot = (b.vx - a.vx) * nx_ + (b.vy - a.vy) * ny_;
+        a.vx += dot * nx_;
+        a.vy += dot * ny_;
+        b.vx -= dot * nx_;
+        b.vy -= dot * ny_;
+        a.surface = -1;
+        b.surface = -1;
+        a.count++;
+        b.count++;
+        disk_collisions++;
+        predict(ev.i, ev.j);
+        predict(ev.j, ev.i);
+    }
+
+    now = t_end;
+}
+
+// Getters
+double HardDiskGas::getTime() const {
+    return now;
+}
+double HardDiskGas::getRadius() const {
+    return radius;
+}
+const SinaiBilliard& HardDiskGas::getWalls() const {
+    return walls;
+}
+Vec2 HardDiskGas::getPosition(int i) const {
+    const Disk& d = disks[i];
+    return {d.x + d.vx * (now - d.t), d.y + d.vy * (now - d.t)};
+}
+Vec2 HardDiskGas::getVelocity(int i) const {
+    return {disks[i].vx, disks[i].vy};
+}
+long long HardDiskGas::getDiskCollisions() const {
+    return disk_collisions;
+}
+long long HardDiskGas::getWallCollisions() const {
+    return wall_collisions;
+}
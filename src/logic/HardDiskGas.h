@@ -0,0 +1,83 @@
+#ifndef HARDDISKGAS_H
+#define HARDDISKGAS_H
+
+#include <functional>
+#include <queue>
+#include <vector>
+#include "Vec2.h"
+#include "SinaiBilliard.h"
+
+using namespace std;
+
+// Event-driven gas of equal hard disks of radius r inside a SinaiBilliard.
+// Disk centres move in a wall table derived from the billiard: the outer boundary
+// inset by r and every scatterer inflated by r, so a disk touching a wall is a point
+// hitting the wall table. Predicted disk-disk, disk-wall and cell-crossing events wait
+// in a priority queue; disks only look for partners in the 3 x 3 cells around them,
+// and an event is dropped when popped if either disk has collided since it was made.
+// Positions are advanced lazily, each disk carrying the time of its last update.
+class HardDiskGas {
+private:
+    struct Disk {
+        double x, y, vx, vy;
+        double t;      // time x, y refer to
+        int count;     // collisions so far, stamps events for lazy invalidation
+        int cx, cy;    // cell
+        int surface;   // wall surface of the last wall collision (-1 = none)
+    };
+
+    enum Kind { DISK, WALL, CELL };
+    struct Event {
+        double t;
+        int i, j;           // disks; for WALL j is the surface, for CELL the new cell as cy * nx + cx
+        int count_i, count_j;
+        Kind kind;
+        bool operator>(const Event& other) const { return t > other.t; }
+    };
+
+    SinaiBilliard walls;
+    double radius;
+    vector<Disk> disks;
+    priority_queue<Event, vector<Event>, greater<Event>> events;
+    double now;
+    bool started;
+    long long disk_collisions, wall_collisions;
+
+    // Cell list over the wall table's bounding box, cells at least one diameter wide
+    double x0, y0, cell;
+    int nx, ny;
+    vector<vector<int>> cells;
+
+    void move(int i, double t);
+    void predict(int i, int skip);
+    void predictWall(int i);
+    void predictDisks(int i, int skip);
+    void predictCell(int i);
+    void insertCell(int i);
+    void eraseCell(int i);
+
+public:
+    HardDiskGas(const SinaiBilliard& billiard, double radius);
+
+    // The wall table for disks of the given radius
+    static SinaiBilliard inset(const SinaiBilliard& billiard, double radius);
+
+    // Places a disk at p with velocity v; returns false, adding nothing, if it would
+    // overlap a wall or another disk
+    bool add(Vec2 p, Vec2 v);
+    int size() const;
+
+    // Processes every event up to time t and moves all disks there
+    void advance(double t);
+
+    // Getters
+    double getTime() const;
+    double getRadius() const;
+    const SinaiBilliard& getWalls() const;
+    Vec2 getPosition(int i) const; // at getTime()
+    Vec2 getVelocity(int i) const;
+    long long getDiskCollisions() const;
+    long long getWallCollisions() const;
+};
+
+#endif //HARDDISKGAS_H
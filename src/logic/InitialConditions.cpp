@@ -0,0 +1,91 @@
+#include "InitialConditions.h"
+#include <cmath>
+#include <stdexcept>
+#include "Philox.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Counter words 2 and 3: the rejection attempt and which quantity is being drawn
+static const uint32_t POSITION = 0, DIRECTION = 1, BIRKHOFF = 2;
+
+InitialConditions::InitialConditions(Kind kind, Vec2 p0, double angle, uint64_t seed)
+    : kind(kind), p0(p0), angle(angle), seed(seed) {}
+
+InitialConditions InitialConditions::fan(Vec2 p0, double angle) {
+    return InitialConditions(FAN, p0, angle, 0);
+}
+
+InitialConditions InitialConditions::interior(uint64_t seed) {
+    return InitialConditions(INTERIOR, {0, 0}, 0, seed);
+}
+
+InitialConditions InitialConditions::boundary(uint64_t seed) {
+    return InitialConditions(BOUNDARY, {0, 0}, 0, seed);
+}
+
+Sample InitialConditions::get(const SinaiBilliard& billiard, uint64_t i) const {
+    Sample sample;
+    if (kind == FAN) {
+        double a = angle + (M_PI * i) / 720;
+        sample.p = p0;
+        sample.d = {cos(a), sin(a)};
+        return sample;
+    }
+
+    if (kind == BOUNDARY) {
+        // Uniform s along the whole boundary, p = sin of the angle to the inward normal
+        array<double, 2> u = Philox::uniform(Philox::generate(i, 0, BIRKHOFF, seed));
+        sample.p = billiard.getPoint(u[0] * billiard.getPerimeter(), sample.surface);
+        double p = 2 * u[1] - 1;
+
+        // Outer normals point out of the table, scatterer normals into it
+        Vec2 n = billiard.getNormal(sample.surface, sample.p);
+        Vec2 inward = sample.surface < billiard.getOuter().getSurfaces() ? n * -1 : n;
+        sample.d = Vec2(-n.y, n.x) * p + inward * sqrt(max(0.0, 1 - p * p));
+        return sample;
+    }
+
+    // Interior: rejection from the bounding box, one counter per attempt
+    Vec2 lo = billiard.getOuter().getLower(), hi = billiard.getOuter().getUpper();
+    for (uint32_t attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+        array<double, 2> u = Philox::uniform(Philox::generate(i, attempt, POSITION, seed));
+        Vec2 p(lo.x + (hi.x - lo.x) * u[0], lo.y + (hi.y - lo.y) * u[1]);
+        if (!billiard.contains(p)) continue;
+
+        double a = 2 * M_PI * Philox::uniform(Philox::generate(i, 0, DIRECTION, seed))[0];
+        sample.p = p;
+        sample.d = {cos(a), sin(a)};
+        return sample;
+    }
+    throw runtime_error("InitialConditions: table has no room for particles");
+}
+
+vector<Sample> InitialConditions::generate(const SinaiBilliard& billiard, uint64_t first, int n, int threads) const {
+    vector<Sample> samples(n);
+    if (n == 0) return samples;
+
+    // The first one on this thread, so a table without room throws here rather than in a worker
+    samples[0] = get(billiard, first);
+    ThreadPool pool(threads);
+    pool.parallel_for(n - 1, 4096, [&](int begin, int end, int) {
+        for (int j = begin + 1; j < end + 1; j++) {
+            samples[j] = get(billiard, first + j);
+        }
+    });
+    return samples;
+}
+
+// Getters
+InitialConditions::Kind InitialConditions::getKind() const {
+    return kind;
+}
+Vec2 InitialConditions::getP0() const {
+    return p0;
+}
+double InitialConditions::getAngle() const {
+    return angle;
+}
+uint64_t InitialConditions::getSeed() const {
+    return seed;
+}
@@ -0,0 +1,53 @@
+#ifndef INITIALCONDITIONS_H
+#define INITIALCONDITIONS_H
+
+#include <cstdint>
+#include <vector>
+#include "Vec2.h"
+#include "SinaiBilliard.h"
+
+using namespace std;
+
+// One starting state: position, unit direction and the surface it sits on (-1 = interior)
+struct Sample {
+    Vec2 p, d;
+    int surface = -1;
+};
+
+// Where the particles of a run start. FAN is the classic one: every particle at p0,
+// particle i heading angle + i * pi / 720. INTERIOR samples the Liouville measure,
+// position uniform over the table minus the scatterers and direction uniform. BOUNDARY
+// samples the invariant measure of the bounce map, uniform in Birkhoff (s, p) with the
+// direction pointing into the table. Random samples come from a Philox counter keyed by
+// the seed, so sample i depends only on (seed, i): any range can be drawn on any thread.
+class InitialConditions {
+public:
+    enum Kind { FAN, INTERIOR, BOUNDARY };
+
+private:
+    Kind kind;
+    Vec2 p0;
+    double angle;
+    uint64_t seed;
+
+    InitialConditions(Kind kind, Vec2 p0, double angle, uint64_t seed);
+
+public:
+    static const int MAX_ATTEMPTS = 1 << 16; // rejection attempts per interior sample
+
+    static InitialConditions fan(Vec2 p0, double angle);
+    static InitialConditions interior(uint64_t seed);
+    static InitialConditions boundary(uint64_t seed);
+
+    Sample get(const SinaiBilliard& billiard, uint64_t i) const;
+    // Samples first .. first + n - 1, filled in parallel; the same for any thread count
+    vector<Sample> generate(const SinaiBilliard& billiard, uint64_t first, int n, int threads = 1) const;
+
+    // Getters
+    Kind getKind() const;
+    Vec2 getP0() const;
+    double getAngle() const;
+    uint64_t getSeed() const;
+};
+
+#endif //INITIALCONDITIONS_H
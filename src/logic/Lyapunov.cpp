@@ -0,0 +1,88 @@
+#include "Lyapunov.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+static const double MIN_COS = 1e-12; // keeps exactly grazing bounces finite
+
+Lyapunov::Lyapunov(const SinaiBilliard& billiard, int renorm)
+    : ensemble(billiard), bounces(0), renorm(max(1, renorm)) {}
+
+void Lyapunov::add(Vec2 p, Vec2 d, int surface) {
+    ensemble.add(p, d, surface);
+    // Start off-axis so the vector has a component along the unstable direction
+    xi.push_back(M_SQRT1_2);
+    phi.push_back(M_SQRT1_2);
+    growth.push_back(0);
+    length.push_back(0);
+    window_growth.push_back(0);
+    window_length.push_back(0);
+}
+
+int Lyapunov::size() const {
+    return ensemble.size();
+}
+
+void Lyapunov::renormalise() {
+    for (int j = 0; j < size(); j++) {
+        double norm = sqrt(xi[j] * xi[j] + phi[j] * phi[j]);
+        double g = log(norm);
+        xi[j] /= norm;
+        phi[j] /= norm;
+        growth[j] += g;
+        window_growth[j] += g;
+    }
+}
+
+void Lyapunov::step() {
+    ensemble.step();
+    const SinaiBilliard& billiard = ensemble.getBilliard();
+
+    for (int j = 0; j < size(); j++) {
+        int s = ensemble.getSurface(j);
+        double tau = ensemble.getFlight(j);
+        if (s < 0 || tau == 0) continue;
+
+        Vec2 p = ensemble.getPosition(j);
+        Vec2 n = billiard.getNormal(s, p);
+        double c = max(MIN_COS, abs(ensemble.getDirection(j).dot(n)));
+        double k = billiard.getCurvature(s, p);
+
+        xi[j] += tau * phi[j];
+        phi[j] += 2 * k / c * xi[j];
+        length[j] += tau;
+        window_length[j] += tau;
+    }
+
+    bounces++;
+    if (bounces % renorm == 0) renormalise();
+}
+
+vector<double> Lyapunov::finiteTime() {
+    if (bounces % renorm != 0) renormalise();
+
+    vector<double> exponents(size());
+    for (int j = 0; j < size(); j++) {
+        exponents[j] = window_length[j] > 0 ? window_growth[j] / window_length[j] : 0;
+        window_growth[j] = 0;
+        window_length[j] = 0;
+    }
+    return exponents;
+}
+
+// Getters
+const Ensemble& Lyapunov::getEnsemble() const {
+    return ensemble;
+}
+long long Lyapunov::getBounces() const {
+    return bounces;
+}
+double Lyapunov::getExponent(int i) const {
+    double g = growth[i] + log(sqrt(xi[i] * xi[i] + phi[i] * phi[i]));
+    return length[i] > 0 ? g / length[i] : 0;
+}
+double Lyapunov::getExponentPerBounce(int i) const {
+    double g = growth[i] + log(sqrt(xi[i] * xi[i] + phi[i] * phi[i]));
+    return bounces > 0 ? g / bounces : 0;
+}
@@ -0,0 +1,49 @@
+#ifndef LYAPUNOV_H
+#define LYAPUNOV_H
+
+#include <vector>
+#include "Vec2.h"
+#include "Ensemble.h"
+
+using namespace std;
+
+// Largest Lyapunov exponent of every particle in an ensemble, from the linearised
+// billiard flow carried along with each trajectory. The tangent vector is a
+// transverse offset xi and an angle offset phi; a free flight of length tau maps it
+// by [1 tau; 0 1] and a bounce on a boundary of curvature k at incidence angle a by
+// [1 0; 2k / cos(a) 1]. It is renormalised every few bounces and the log stretch
+// factors are summed, so nothing overflows and no second trajectory is needed.
+class Lyapunov {
+private:
+    Ensemble ensemble;
+    vector<double> xi, phi;                    // tangent vectors
+    vector<double> growth, length;             // summed log stretch and flight length since the start
+    vector<double> window_growth, window_length; // the same since the last finite-time report
+    long long bounces;
+    int renorm;                                // bounces between renormalisations
+
+    void renormalise();
+
+public:
+    static const int RENORM = 8;
+
+    // billiard is held by reference and must outlive the engine
+    explicit Lyapunov(const SinaiBilliard& billiard, int renorm = RENORM);
+
+    void add(Vec2 p, Vec2 d, int surface = -1);
+    int size() const;
+
+    // Advance every particle by one bounce, tangent vectors included
+    void step();
+
+    // Exponents per unit length over the bounces since the last call, then starts a new window
+    vector<double> finiteTime();
+
+    // Getters
+    const Ensemble& getEnsemble() const;
+    long long getBounces() const;
+    double getExponent(int i) const;          // per unit length since the start
+    double getExponentPerBounce(int i) const; // per collision since the start
+};
+
+#endif //LYAPUNOV_H
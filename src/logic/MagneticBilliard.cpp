@@ -0,0 +1,230 @@
+#include "MagneticBilliard.h"
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+static const double EPS_POINT = 1e-7;  // roots this close to the start point are the start itself
+static const double EPS_ARC = 1e-9;    // slack on arc end angles and segment ends
+static const double EPS_START = 1e-6;  // orbit length skipped at either end when starting on an ellipse
+static const double ON_ELLIPSE = 1e-9; // |implicit function| below which the start lies on the ellipse
+
+MagneticBilliard::MagneticBilliard(const SinaiBilliard& billiard, double field)
+    : billiard(billiard), field(field),
+      radius(field != 0 ? 1 / abs(field) : numeric_limits<double>::infinity()),
+      sign(field >= 0 ? 1 : -1) {}
+
+MagneticBilliard::Orbit MagneticBilliard::orbit(Vec2 p, Vec2 d) const {
+    Orbit o;
+    o.center = p + Vec2(-d.y, d.x) * (radius * sign);
+    o.phase = atan2(p.y - o.center.y, p.x - o.center.x);
+    return o;
+}
+
+double MagneticBilliard::arcLength(const Orbit& o, Vec2 q) const {
+    double theta = atan2(q.y - o.center.y, q.x - o.center.x);
+    double delta = fmod(sign * (theta - o.phase), 2 * M_PI);
+    if (delta < 0) delta += 2 * M_PI;
+    return radius * delta;
+}
+
+void MagneticBilliard::consider(const Orbit& o, Vec2 p, int surface, Vec2 q, Hit& hit) const {
+    if ((q - p).mag() < EPS_POINT) return;
+    double s = arcLength(o, q);
+    if (s < hit.t) {
+        hit.surface = surface;
+        hit.t = s;
+        hit.point = q;
+    }
+}
+
+// Whether q, a point of e's ellipse, lies within the arc's parameter range
+static bool onArc(const Edge& e, Vec2 q) {
+    double phi = atan2((q.y - e.center.y) / e.ry, (q.x - e.center.x) / e.rx);
+    double delta = fmod(e.sweep > 0 ? phi - e.start : e.start - phi, 2 * M_PI);
+    if (delta < 0) delta += 2 * M_PI;
+    return delta <= abs(e.sweep) + EPS_ARC || delta >= 2 * M_PI - EPS_ARC;
+}
+
+void MagneticBilliard::circlePass(const Orbit& o, Vec2 p, int surface, Vec2 center, double r,
+                                  const Edge* arc, Hit& hit) const {
+    Vec2 w = center - o.center;
+    double dist = w.mag();
+    if (dist == 0 || dist > radius + r || dist < abs(radius - r)) return;
+
+    // Chord through both intersections: a along the line of centres, h either side of it
+    double a = (radius * radius - r * r + dist * dist) / (2 * dist);
+    double h = sqrt(max(0.0, radius * radius - a * a));
+    Vec2 u = w / dist;
+    Vec2 mid = o.center + u * a;
+    Vec2 roots[2] = {mid + Vec2(-u.y, u.x) * h, mid - Vec2(-u.y, u.x) * h};
+    for (Vec2 q : roots) {
+        if (arc && !onArc(*arc, q)) continue;
+        consider(o, p, surface, q, hit);
+    }
+}
+
+void MagneticBilliard::linePass(const Orbit& o, Vec2 p, int surface, const Edge& e, Hit& hit) const {
+    Vec2 u = e.p1 - e.p0;
+    double length = u.mag();
+    u = u / length;
+
+    Vec2 w = o.center - e.p0;
+    double along = w.dot(u);
+    double dist2 = w.dot(w) - along * along;
+    if (dist2 > radius * radius) return;
+    double h = sqrt(radius * radius - dist2);
+    for (double k : {along - h, along + h}) {
+        if (k < -EPS_ARC || k > length + EPS_ARC) continue;
+        consider(o, p, surface, e.p0 + u * k, hit);
+    }
+}
+
+void MagneticBilliard::ellipsePass(const Orbit& o, Vec2 p, int surface, const Edge& e, Hit& hit) const {
+    // Implicit ellipse function a distance delta (in radians of orbit) along the flight:
+    // negative inside, positive outside
+    auto f = [&](double delta) {
+        double theta = o.phase + sign * delta;
+        double x = (o.center.x + radius * cos(theta) - e.center.x) / e.rx;
+        double y = (o.center.y + radius * sin(theta) - e.center.y) / e.ry;
+        return x * x + y * y - 1;
+    };
+    // Root of f in [lo, hi], where f changes sign
+    auto bisect = [&](double lo, double hi) {
+        double flo = f(lo);
+        for (int i = 0; i < 60; i++) {
+            double mid = (lo + hi) / 2, fm = f(mid);
+            if ((fm < 0) == (flo < 0)) {
+                lo = mid;
+                flo = fm;
+            } else {
+                hi = mid;
+            }
+        }
+        return (lo + hi) / 2;
+    };
+    auto candidate = [&](double delta) {
+        double theta = o.phase + sign * delta;
+        Vec2 q = o.center + Vec2(cos(theta), sin(theta)) * radius;
+        if (onArc(e, q)) consider(o, p, surface, q, hit);
+    };
+
+    // Only the stretch of orbit inside the ellipse's circumscribed circle can meet it
+    double bound = max(e.rx, e.ry);
+    Vec2 w = e.center - o.center;
+    double dist = w.mag();
+    if (dist > radius + bound || dist + bound < radius) return;
+    double begin = 0, length = 2 * M_PI;
+    if (dist + radius > bound) {
+        double half = acos(max(-1.0, min(1.0, (radius * radius + dist * dist - bound * bound) / (2 * radius * dist))));
+        begin = fmod(sign * (atan2(w.y, w.x) - o.phase) - half, 2 * M_PI);
+        if (begin < 0) begin += 2 * M_PI;
+        length = 2 * half;
+    }
+
+    // Starting on this ellipse, on this arc or a neighbouring one, f is zero right at the
+    // start and again after a full turn; step off both ends so the brackets see the side
+    // the particle is heading to
+    double skip = abs(f(0)) < ON_ELLIPSE ? EPS_START / radius : 0;
+
+    // The window may wrap past the start of the flight, then it is scanned in two pieces
+    double pieces[2][2] = {{begin, min(begin + length, 2 * M_PI)}, {0, begin + length - 2 * M_PI}};
+    for (const auto& piece : pieces) {
+        double lo = max(piece[0], skip), hi = min(piece[1], 2 * M_PI - skip);
+        if (hi <= lo) continue;
+
+        // Samples a fixed fraction of the smaller radius apart. A sign change between two
+        // samples brackets one crossing; an extremum of f that turns back towards zero may
+        // hide two, so it is located and, if f crosses there, split at it
+        int n = max(2, static_cast<int>(ceil((hi - lo) * radius * SAMPLES / min(e.rx, e.ry))));
+        double step = (hi - lo) / n;
+        double d0 = lo, f0 = f(d0), d1 = lo + step, f1 = f(d1);
+        if ((f0 < 0) != (f1 < 0)) candidate(bisect(d0, d1));
+        for (int k = 2; k <= n; k++) {
+            double d2 = lo + step * k, f2 = f(d2);
+            if ((f1 < 0) != (f2 < 0)) candidate(bisect(d1, d2));
+            else if ((f0 < 0) == (f1 < 0) && abs(f1) < abs(f0) && abs(f1) < abs(f2)) {
+                // Golden-section search for the extremum of f, towards zero
+                double s = f1 < 0 ? -1 : 1, a = d0, b = d2;
+                const double g = (sqrt(5.0) - 1) / 2;
+                double x1 = b - g * (b - a), x2 = a + g * (b - a), g1 = s * f(x1), g2 = s * f(x2);
+                for (int i = 0; i < 60; i++) {
+                    if (g1 < g2) {
+                        b = x2; x2 = x1; g2 = g1;
+                        x1 = b - g * (b - a); g1 = s * f(x1);
+                    } else {
+                        a = x1; x1 = x2; g1 = g2;
+                        x2 = a + g * (b - a); g2 = s * f(x2);
+                    }
+                }
+                double m = (a + b) / 2;
+                if (s * f(m) < 0) {
+                    candidate(bisect(d0, m));
+                    candidate(bisect(m, d2));
+                }
+            }
+            d0 = d1; f0 = f1;
+            d1 = d2; f1 = f2;
+        }
+    }
+}
+
+Hit MagneticBilliard::intersect(Vec2 p, Vec2 d, int from) const {
+    d = d.normalize();
+    if (field == 0) return billiard.intersect(p, d, from);
+
+    Orbit o = orbit(p, d);
+    Hit hit;
+    hit.t = numeric_limits<double>::infinity();
+
+    // --- Outer boundary ---
+    const vector<Edge>& edges = billiard.getOuter().getEdges();
+    for (int i = 0; i < static_cast<int>(edges.size()); i++) {
+        const Edge& e = edges[i];
+        if (e.degenerate()) continue;
+        if (!e.arc) {
+            linePass(o, p, i, e, hit);
+        } else if (abs(e.rx - e.ry) <= 1e-12 * e.rx) {
+            circlePass(o, p, i, e.center, e.rx, &e, hit);
+        } else {
+            ellipsePass(o, p, i, e, hit);
+        }
+    }
+
+    // --- Scatterers ---
+    const vector<Circle>& circles = billiard.getScatterers();
+    int base = billiard.getOuter().getSurfaces();
+    for (int k = 0; k < static_cast<int>(circles.size()); k++) {
+        circlePass(o, p, base + k, circles[k].center, circles[k].radius, nullptr, hit);
+    }
+
+    if (hit.surface < 0) {
+        hit.t = 0;
+        return hit;
+    }
+    hit.normal = billiard.getNormal(hit.surface, hit.point);
+    return hit;
+}
+
+Vec2 MagneticBilliard::advance(Vec2 p, Vec2 d, double s, Vec2& velocity) const {
+    d = d.normalize();
+    if (field == 0) {
+        velocity = d;
+        return p + d * s;
+    }
+    Orbit o = orbit(p, d);
+    double phi = o.phase + sign * s / radius;
+    velocity = Vec2(-sin(phi), cos(phi)) * sign;
+    return o.center + Vec2(cos(phi), sin(phi)) * radius;
+}
+
+// Getters
+const SinaiBilliard& MagneticBilliard::getBilliard() const {
+    return billiard;
+}
+double MagneticBilliard::getField() const {
+    return field;
+}
+double MagneticBilliard::getRadius() const {
+    return radius;
+}
@@ -0,0 +1,54 @@
+#ifndef MAGNETICBILLIARD_H
+#define MAGNETICBILLIARD_H
+
+#include <vector>
+#include "Vec2.h"
+#include "SinaiBilliard.h"
+
+using namespace std;
+
+// Billiard in a uniform perpendicular magnetic field. Between bounces a unit-speed
+// particle runs along a Larmor circle of radius 1 / |field|, counter-clockwise for
+// field > 0, so every flight is an arc known in closed form. Hits on segments, circular
+// arcs and scatterers are circle-line and circle-circle intersections; elliptic arcs are
+// bracketed by sampling the orbit where it passes within reach of the ellipse, at steps
+// that scale with the ellipse rather than the orbit, and refined by bisection. field == 0 is the ordinary
+// straight-line billiard.
+class MagneticBilliard {
+private:
+    const SinaiBilliard& billiard; // not owned, must outlive this
+    double field;
+    double radius;   // Larmor radius
+    double sign;     // +1 counter-clockwise, -1 clockwise
+
+    struct Orbit {
+        Vec2 center;
+        double phase; // angle of the start point about the center
+    };
+
+    Orbit orbit(Vec2 p, Vec2 d) const;
+    double arcLength(const Orbit& o, Vec2 q) const; // along the orbit from its start to q, in [0, 2 pi r)
+    void consider(const Orbit& o, Vec2 p, int surface, Vec2 q, Hit& hit) const;
+    void circlePass(const Orbit& o, Vec2 p, int surface, Vec2 center, double r, const Edge* arc, Hit& hit) const;
+    void linePass(const Orbit& o, Vec2 p, int surface, const Edge& e, Hit& hit) const;
+    void ellipsePass(const Orbit& o, Vec2 p, int surface, const Edge& e, Hit& hit) const;
+
+public:
+    static const int SAMPLES = 16; // orbit samples per min(rx, ry) of flight when bracketing an elliptic arc
+
+    // billiard is held by reference, not copied
+    MagneticBilliard(const SinaiBilliard& billiard, double field);
+
+    // Next bounce of the particle at p with unit velocity d; hit.t is the arc length flown.
+    // `from` is the surface p lies on. No hit (surface -1) if the orbit never meets the boundary.
+    Hit intersect(Vec2 p, Vec2 d, int from = -1) const;
+    // Position and unit velocity a distance s along the orbit through p with velocity d
+    Vec2 advance(Vec2 p, Vec2 d, double s, Vec2& velocity) const;
+
+    // Getters
+    const SinaiBilliard& getBilliard() const;
+    double getField() const;
+    double getRadius() const;
+};
+
+#endif //MAGNETICBILLIARD_H
@@ -0,0 +1,111 @@
+#include "Occupation.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+OccupationHistogram::OccupationHistogram(int nx, int ny, Vec2 lower, Vec2 upper)
+    : nx(nx), ny(ny), lower(lower), upper(upper),
+      cellX((upper.x - lower.x) / nx), cellY((upper.y - lower.y) / ny),
+      unit(min(cellX, cellY) / (1 << UNIT_BITS)), perUnit(1 / unit),
+      counts(static_cast<size_t>(nx) * ny, 0), total(0) {}
+
+void OccupationHistogram::deposit(int i, int j, double length) {
+    uint64_t n = static_cast<uint64_t>(length * perUnit + 0.5);
+    counts[static_cast<size_t>(i) * ny + j] += n;
+    total += n;
+}
+
+void OccupationHistogram::addSegment(Vec2 a, Vec2 b) {
+    Vec2 d = b - a;
+    double length = d.mag();
+    if (length == 0) return;
+
+    // --- Clip to the grid, t in [0, 1] along the segment ---
+    const double inf = numeric_limits<double>::infinity();
+    double t_in = 0, t_out = 1;
+    if (d.x != 0) {
+        double ta = (lower.x - a.x) / d.x, tb = (upper.x - a.x) / d.x;
+        t_in = max(t_in, min(ta, tb));
+        t_out = min(t_out, max(ta, tb));
+    } else if (a.x < lower.x || a.x > upper.x) {
+        return;
+    }
+    if (d.y != 0) {
+        double ta = (lower.y - a.y) / d.y, tb = (upper.y - a.y) / d.y;
+        t_in = max(t_in, min(ta, tb));
+        t_out = min(t_out, max(ta, tb));
+    } else if (a.y < lower.y || a.y > upper.y) {
+        return;
+    }
+    if (t_in >= t_out) return;
+
+    // --- DDA walk, one deposit per cell crossed ---
+    Vec2 q = a + d * t_in;
+    int i = min(nx - 1, max(0, static_cast<int>(floor((q.x - lower.x) / cellX))));
+    int j = min(ny - 1, max(0, static_cast<int>(floor((q.y - lower.y) / cellY))));
+    int step_i = d.x > 0 ? 1 : -1;
+    int step_j = d.y > 0 ? 1 : -1;
+    double next_x = d.x != 0 ? (lower.x + (i + (d.x > 0)) * cellX - a.x) / d.x : inf;
+    double next_y = d.y != 0 ? (lower.y + (j + (d.y > 0)) * cellY - a.y) / d.y : inf;
+    double delta_x = d.x != 0 ? cellX / abs(d.x) : inf;
+    double delta_y = d.y != 0 ? cellY / abs(d.y) : inf;
+
+    double t = t_in;
+    while (t < t_out) {
+        double t_next = min(t_out, min(next_x, next_y));
+        if (t_next > t) deposit(i, j, (t_next - t) * length);
+        t = t_next;
+        if (t >= t_out) break;
+
+        if (next_x < next_y) {
+            i += step_i;
+            next_x += delta_x;
+        } else {
+            j += step_j;
+            next_y += delta_y;
+        }
+        if (i < 0 || i >= nx || j < 0 || j >= ny) break;
+    }
+}
+
+void OccupationHistogram::merge(const OccupationHistogram& other) {
+    for (size_t k = 0; k < counts.size(); k++) {
+        counts[k] += other.counts[k];
+    }
+    total += other.total;
+}
+
+vector<float> OccupationHistogram::getDensity() const {
+    vector<float> density(counts.size(), 0.0f);
+    uint64_t peak = counts.empty() ? 0 : *max_element(counts.begin(), counts.end());
+    if (peak == 0) return density;
+    for (size_t k = 0; k < counts.size(); k++) {
+        density[k] = static_cast<float>(static_cast<double>(counts[k]) / peak);
+    }
+    return density;
+}
+
+// Getters
+int OccupationHistogram::getNx() const {
+    return nx;
+}
+int OccupationHistogram::getNy() const {
+    return ny;
+}
+Vec2 OccupationHistogram::getLower() const {
+    return lower;
+}
+Vec2 OccupationHistogram::getUpper() const {
+    return upper;
+}
+double OccupationHistogram::getUnit() const {
+    return unit;
+}
+uint64_t OccupationHistogram::getTotal() const {
+    return total;
+}
+const vector<uint64_t>& OccupationHistogram::getCounts() const {
+    return counts;
+}
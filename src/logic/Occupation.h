@@ -0,0 +1,48 @@
+#ifndef OCCUPATION_H
+#define OCCUPATION_H
+
+#include <cstdint>
+#include <vector>
+#include "Vec2.h"
+
+using namespace std;
+
+// Occupation density of the billiard flow: the path length particles spend in each cell
+// of an nx x ny grid over [lower, upper]. Free flights are walked cell by cell, so every
+// cell gets exactly the length of segment inside it. Lengths are kept as integer
+// multiples of a small unit, which makes merging histograms filled on different threads
+// give the same result in any order.
+class OccupationHistogram {
+private:
+    int nx, ny;
+    Vec2 lower, upper;
+    double cellX, cellY;
+    double unit, perUnit;    // length of one count, and its inverse
+    vector<uint64_t> counts; // x-major, like the quantum grid: counts[i * ny + j]
+    uint64_t total;
+
+    void deposit(int i, int j, double length);
+
+public:
+    static const int UNIT_BITS = 20; // 2^UNIT_BITS counts to the shorter cell side
+
+    OccupationHistogram(int nx, int ny, Vec2 lower, Vec2 upper);
+
+    // Adds the free flight from a to b; parts outside the grid are dropped
+    void addSegment(Vec2 a, Vec2 b);
+    void merge(const OccupationHistogram& other);
+
+    // Share of the total length in each cell, scaled so the fullest cell is 1
+    vector<float> getDensity() const;
+
+    // Getters
+    int getNx() const;
+    int getNy() const;
+    Vec2 getLower() const;
+    Vec2 getUpper() const;
+    double getUnit() const;
+    uint64_t getTotal() const;
+    const vector<uint64_t>& getCounts() const;
+};
+
+#endif //OCCUPATION_H
@@ -0,0 +1,135 @@
+#include "ScattererGrid.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+static const int GRID_MAX_CELLS = 1024; // per axis
+
+ScattererGrid::ScattererGrid(Vec2 lo, Vec2 hi)
+    : x0(lo.x), y0(lo.y), x1(hi.x), y1(hi.y), cell(0), nx(0), ny(0), built(0) {}
+
+bool ScattererGrid::active() const {
+    return !cells.empty();
+}
+
+void ScattererGrid::insertCell(const Circle& c, int i) {
+    auto clampX = [&](double x) { return min(nx - 1, max(0, static_cast<int>(floor((x - x0) / cell)))); };
+    auto clampY = [&](double y) { return min(ny - 1, max(0, static_cast<int>(floor((y - y0) / cell)))); };
+
+    int i0 = clampX(c.center.x - c.radius), i1 = clampX(c.center.x + c.radius);
+    int j0 = clampY(c.center.y - c.radius), j1 = clampY(c.center.y + c.radius);
+    for (int j = j0; j <= j1; j++) {
+        for (int k = i0; k <= i1; k++) {
+            cells[j * nx + k].push_back(i);
+        }
+    }
+}
+
+void ScattererGrid::rebuild(const vector<Circle>& circles) {
+    int n = static_cast<int>(circles.size());
+    cells.clear();
+    built = n;
+    if (n < GRID_MIN) return;
+
+    // About one scatterer per cell, but never smaller than a typical scatterer
+    double width = x1 - x0;
+    double height = y1 - y0;
+    double mean_r = 0;
+    for (const auto& c : circles) mean_r += c.radius;
+    mean_r /= n;
+
+    cell = max(sqrt(width * height / n), 2 * mean_r);
+    cell = max(cell, max(width, height) / GRID_MAX_CELLS);
+    nx = max(1, static_cast<int>(ceil(width / cell)));
+    ny = max(1, static_cast<int>(ceil(height / cell)));
+
+    cells.assign(nx * ny, vector<int>());
+    for (int i = 0; i < n; i++) {
+        insertCell(circles[i], i);
+    }
+}
+
+void ScattererGrid::insert(const vector<Circle>& circles, int i) {
+    if (!active() || i >= 2 * built) {
+        rebuild(circles);
+        return;
+    }
+    insertCell(circles[i], i);
+}
+
+int ScattererGrid::intersect(const vector<Circle>& circles, Vec2 p, Vec2 d,
+                             double t_max, int exclude, double& t_hit) const {
+    int best = -1;
+    t_hit = t_max;
+
+    auto test = [&](int k) {
+        const Circle& c = circles[k];
+        Vec2 f = p - c.center;
+        double B = f.dot(d);
+        double C = f.dot(f) - c.radius * c.radius;
+        double disc = B * B - C;
+        if (disc < 0 || k == exclude) return;
+        double t = -B - sqrt(disc);
+        if (t > 1e-9 && t < t_hit) {
+            t_hit = t;
+            best = k;
+        }
+    };
+
+    if (!active()) {
+        for (int k = 0; k < static_cast<int>(circles.size()); k++) test(k);
+        return best;
+    }
+
+    // --- Clip the ray to the grid ---
+    const double inf = numeric_limits<double>::infinity();
+    double t_in = 0;
+    double t_out = t_max;
+    if (d.x != 0) {
+        double ta = (x0 - p.x) / d.x, tb = (x1 - p.x) / d.x;
+        t_in = max(t_in, min(ta, tb));
+        t_out = min(t_out, max(ta, tb));
+    } else if (p.x < x0 || p.x > x1) {
+        return -1;
+    }
+    if (d.y != 0) {
+        double ta = (y0 - p.y) / d.y, tb = (y1 - p.y) / d.y;
+        t_in = max(t_in, min(ta, tb));
+        t_out = min(t_out, max(ta, tb));
+    } else if (p.y < y0 || p.y > y1) {
+        return -1;
+    }
+    if (t_in > t_out) return -1;
+
+    // --- DDA walk ---
+    Vec2 q = p + d * t_in;
+    int ix = min(nx - 1, max(0, static_cast<int>(floor((q.x - x0) / cell))));
+    int iy = min(ny - 1, max(0, static_cast<int>(floor((q.y - y0) / cell))));
+    int step_x = d.x > 0 ? 1 : -1;
+    int step_y = d.y > 0 ? 1 : -1;
+    double next_x = d.x != 0 ? (x0 + (ix + (d.x > 0)) * cell - p.x) / d.x : inf;
+    double next_y = d.y != 0 ? (y0 + (iy + (d.y > 0)) * cell - p.y) / d.y : inf;
+    double delta_x = d.x != 0 ? cell / abs(d.x) : inf;
+    double delta_y = d.y != 0 ? cell / abs(d.y) : inf;
+
+    while (true) {
+        for (int k : cells[iy * nx + ix]) test(k);
+
+        // A hit inside the current cell cannot be beaten by anything further along
+        double t_exit = min(next_x, next_y);
+        if (t_hit <= t_exit || t_exit > t_out) break;
+
+        if (next_x < next_y) {
+            ix += step_x;
+            if (ix < 0 || ix >= nx) break;
+            next_x += delta_x;
+        } else {
+            iy += step_y;
+            if (iy < 0 || iy >= ny) break;
+            next_y += delta_y;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,44 @@
+#ifndef SCATTERERGRID_H
+#define SCATTERERGRID_H
+
+#include <vector>
+#include "Vec2.h"
+
+using namespace std;
+
+struct Circle {
+    Vec2 center;
+    double radius;
+};
+
+// Uniform grid over the table's bounding box holding, per cell, the indices of
+// the scatterers whose bounding box overlaps it. Rays are walked cell by cell
+// (Amanatides-Woo DDA) so a query only tests the scatterers it passes near.
+// Below GRID_MIN scatterers the grid stays inactive and queries scan linearly.
+class ScattererGrid {
+private:
+    double x0, y0, x1, y1;      // grid bounds
+    double cell;                // cell side
+    int nx, ny;                 // cell counts
+    int built;                  // number of scatterers at the last rebin
+    vector<vector<int>> cells;  // scatterer indices per cell, row-major in y
+
+    void insertCell(const Circle& c, int i);
+
+public:
+    static const int GRID_MIN = 16;
+
+    ScattererGrid(Vec2 lo, Vec2 hi);
+
+    // Register circles[i]; rebins once the count doubles so insertion stays amortised O(1)
+    void insert(const vector<Circle>& circles, int i);
+    void rebuild(const vector<Circle>& circles);
+    bool active() const;
+
+    // Nearest scatterer hit along p + t * d with t in (1e-9, t_max), skipping `exclude`.
+    // Returns its index and sets t_hit, or returns -1.
+    int intersect(const vector<Circle>& circles, Vec2 p, Vec2 d,
+                  double t_max, int exclude, double& t_hit) const;
+};
+
+#endif //SCATTERERGRID_H
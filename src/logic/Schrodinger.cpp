@@ -2,11 +2,9 @@
 #include <cmath>
 #include <numeric>
 #include "Utils.h"
+#include "ThreadPool.h"
 #include <iostream>
-#include <Eigen/Core>
-#include <Spectra/GenEigsSolver.h>
 
-using namespace Spectra;
 using namespace std;
 
 Schrodinger::Schrodinger(int Nx, int Ny, double dh, double dt, double sigma)
@@ -72,7 +70,7 @@ void Schrodinger::laplacian_inplace(
                 up = {0.0, 0.0};
             }
 
-            result[id] = (left + right + up + down - 4.0 * psi[id]) / dh_sq;
+            result[id] = Stencil::laplacian_at(left, right, up, down, psi[id], dh_sq);
         }
     }
 }
@@ -80,39 +78,345 @@ void Schrodinger::laplacian_inplace(
 vector<complex<double>> Schrodinger::RK4_Schrodinger(
     const vector<complex<double>>& psi,
     const vector<int>& boundary, int Nx, int Ny) const {
+    return RK4_Schrodinger(psi, Stencil(Nx, Ny, dh, boundary));
+}
+
+vector<complex<double>> Schrodinger::RK4_Schrodinger(
+    const vector<complex<double>>& psi, const Stencil& stencil) const {
+    stencil.load(psi, split_psi);
+    RK4_inplace(stencil, split_psi);
+
+    // Walls do not evolve, so they keep their values from psi
+    vector<complex<double>> result = psi;
+    stencil.store(split_psi, result);
+    return result;
+}
 
-    int size = Nx * Ny;
+// One fused RK4 stage over rows [i0, i1): k = -i/2 Lap(in), then sum = base + w * k and,
+// unless this is the last stage, next = psi + a * k. A null base accumulates into sum.
+struct Stage {
+    const SplitField* in;
+    const SplitField* base;
+    SplitField* sum;
+    double w;
+    SplitField* next;
+    double a;
+};
 
-    // Helper function that computes the derivative in-place
-    auto compute_derivative = [&](const vector<complex<double>>& state, vector<complex<double>>& result) {
-        laplacian_inplace(state, boundary, result, Nx, Ny);  // Use in-place version
-        for (int id = 0; id < size; id++) {
-            result[id] *= -im * 0.5;  // Apply the physics factor
+// Every plane a row touches is passed separately as __restrict, which the vectoriser
+// needs: there are too many of them for it to version the loop on runtime alias checks.
+// Read-only planes may coincide (psi is both the input and psi of the first stage).
+// The input rows above and below are at offsets up and down from in, so they need not
+// be stride apart.
+template <bool IN_PLACE, bool NEXT>
+static void stage_row(const double* __restrict in_re, const double* __restrict in_im, const double* __restrict m,
+                      const double* __restrict base_re, const double* __restrict base_im,
+                      double* __restrict sum_re, double* __restrict sum_im,
+                      const double* __restrict psi_re, const double* __restrict psi_im,
+                      double* __restrict next_re, double* __restrict next_im,
+                      int n, int up, int down, double dh_sq, double w, double a) {
+    for (int j = 0; j < n; j++) {
+        double lap_re = m[j] * Stencil::laplacian_at(in_re[j + up], in_re[j + down], in_re[j + 1], in_re[j - 1], in_re[j], dh_sq);
+        double lap_im = m[j] * Stencil::laplacian_at(in_im[j + up], in_im[j + down], in_im[j + 1], in_im[j - 1], in_im[j], dh_sq);
+        double k_re = 0.5 * lap_im, k_im = -0.5 * lap_re;
+        sum_re[j] = (IN_PLACE ? sum_re[j] : base_re[j]) + w * k_re;
+        sum_im[j] = (IN_PLACE ? sum_im[j] : base_im[j]) + w * k_im;
+        if (NEXT) {
+            next_re[j] = psi_re[j] + a * k_re;
+            next_im[j] = psi_im[j] + a * k_im;
         }
+    }
+}
+
+using RowKernel = decltype(&stage_row<false, false>);
+
+static RowKernel kernel(bool base, bool next) {
+    return base ? (next ? stage_row<false, true> : stage_row<false, false>)
+                : (next ? stage_row<true, true> : stage_row<true, false>);
+}
+
+static void rk4_stage(const Stencil& stencil, const SplitField& psi, const Stage& stage, int i0, int i1) {
+    int ny = stencil.getNy(), stride = stencil.getStride();
+    double dh_sq = stencil.getDh() * stencil.getDh();
+    auto row_kernel = kernel(stage.base != nullptr, stage.next != nullptr);
+    for (int i = i0; i < i1; i++) {
+        int row = stencil.index(i, 0);
+        row_kernel(stage.in->re.data() + row, stage.in->im.data() + row, stencil.getMask().data() + row,
+                   stage.base ? stage.base->re.data() + row : nullptr,
+                   stage.base ? stage.base->im.data() + row : nullptr,
+                   stage.sum->re.data() + row, stage.sum->im.data() + row,
+                   stage.next ? psi.re.data() + row : nullptr,
+                   stage.next ? psi.im.data() + row : nullptr,
+                   stage.next ? stage.next->re.data() + row : nullptr,
+                   stage.next ? stage.next->im.data() + row : nullptr,
+                   ny, -stride, stride, dh_sq, stage.w, stage.a);
+    }
+}
+
+// Ring rows of a worker's scratch: three rows each of the stage 1, 2 and 3 inputs, four
+// of the running sum, and a row of zeros standing in for the ghost rows
+static const int RING_STAGE = 3, RING_SUM = 4, RING_ROWS = 3 * RING_STAGE + RING_SUM + 1;
+
+// One RK4 step of rows [r0, r1) of psi into out, with every stage streamed row by row
+// through the ring. Iteration t computes stage s on row t - s, so each stage's input
+// rows are at most one iteration old. Stage s runs 3 - s rows past both ends of the
+// band, which is exactly what the stages after it read, and nothing but the last stage
+// touches out. The cells see the same arithmetic as in rk4_stage.
+static void rk4_band(const Stencil& stencil, const SplitField& psi, SplitField& out, SplitField& ring,
+                     double dt, int r0, int r1) {
+    int nx = stencil.getNx(), ny = stencil.getNy(), stride = stencil.getStride();
+    double dh_sq = stencil.getDh() * stencil.getDh();
+    const double w[4] = {dt / 6.0, dt / 3.0, dt / 3.0, dt / 6.0};
+    const double a[4] = {0.5 * dt, 0.5 * dt, dt, 0.0};
+    const int zero = (RING_ROWS - 1) * stride + 1;
+
+    // Offset of ring row x of stage input s (1..3), or of the sum
+    auto slot = [&](int s, int x) {
+        if (x < 0 || x >= nx) return zero;
+        return ((s - 1) * RING_STAGE + (x % RING_STAGE)) * stride + 1;
+    };
+    auto sum = [&](int x) {
+        return (3 * RING_STAGE + x % RING_SUM) * stride + 1;
     };
 
-    // Compute k1 = f(psi)
-    compute_derivative(psi, k1);
+    for (int t = r0 - 3; t < r1 + 3; t++) {
+        for (int s = 0; s < 4; s++) {
+            int x = t - s;
+            if (x < max(0, r0 - 3 + s) || x >= min(nx, r1 + 3 - s)) continue;
+            int row = stencil.index(x, 0);
+            const double* m = stencil.getMask().data() + row;
+            const double* base_re = nullptr;
+            const double* base_im = nullptr;
+            const double* psi_re = nullptr;
+            const double* psi_im = nullptr;
+            double* next_re = nullptr;
+            double* next_im = nullptr;
+            double* sum_re = ring.re.data() + sum(x);
+            double* sum_im = ring.im.data() + sum(x);
 
-    // Compute k2 = f(psi + 0.5*dt*k1)
-    add_scaled_inplace(temp_state, psi, k1, 0.5 * dt, size);
-    compute_derivative(temp_state, k2);
+            const double* in_re;
+            const double* in_im;
+            int up, down;
+            if (s == 0) {
+                in_re = psi.re.data() + row;
+                in_im = psi.im.data() + row;
+                up = -stride;
+                down = stride;
+                base_re = in_re;
+                base_im = in_im;
+            } else {
+                int mid = slot(s, x);
+                in_re = ring.re.data() + mid;
+                in_im = ring.im.data() + mid;
+                up = slot(s, x - 1) - mid;
+                down = slot(s, x + 1) - mid;
+            }
+            if (s < 3) {
+                psi_re = psi.re.data() + row;
+                psi_im = psi.im.data() + row;
+                next_re = ring.re.data() + slot(s + 1, x);
+                next_im = ring.im.data() + slot(s + 1, x);
+            } else {
+                base_re = sum_re;
+                base_im = sum_im;
+                sum_re = out.re.data() + row;
+                sum_im = out.im.data() + row;
+            }
 
-    // Compute k3 = f(psi + 0.5*dt*k2)
-    add_scaled_inplace(temp_state, psi, k2, 0.5 * dt, size);
-    compute_derivative(temp_state, k3);
+            kernel(base_re != nullptr, next_re != nullptr)(in_re, in_im, m, base_re, base_im, sum_re, sum_im,
+                                                          psi_re, psi_im, next_re, next_im,
+                                                          ny, up, down, dh_sq, w[s], a[s]);
+        }
+    }
+}
 
-    // Compute k4 = f(psi + dt*k3)
-    add_scaled_inplace(temp_state, psi, k3, dt, size);
-    compute_derivative(temp_state, k4);
+void Schrodinger::RK4_inplace(const Stencil& stencil, SplitField& psi) const {
+    if (split_acc.re.size() != psi.re.size()) {
+        split_acc = split_stage[0] = split_stage[1] = stencil.field();
+    }
+    SplitField& acc = split_acc;
+    SplitField* stage = split_stage;
 
-    // Final result: psi + (dt/6)*(k1 + 2*k2 + 2*k3 + k4)
-    vector<complex<double>> result(size);
-    for (int id = 0; id < size; id++) {
-        result[id] = psi[id] + (dt/6.0) * (k1[id] + 2.0*k2[id] + 2.0*k3[id] + k4[id]);
+    // acc = psi + dt/6 (k1 + 2 k2 + 2 k3) builds up across the stages; the last one
+    // writes acc + dt/6 k4 straight over psi, which no longer needs its old values
+    const Stage stages[4] = {
+        {&psi,      &psi,    &acc, dt / 6.0, &stage[0], 0.5 * dt},
+        {&stage[0], nullptr, &acc, dt / 3.0, &stage[1], 0.5 * dt},
+        {&stage[1], nullptr, &acc, dt / 3.0, &stage[0], dt},
+        {&stage[0], &acc,    &psi, dt / 6.0, nullptr,   0.0},
+    };
+    for (const Stage& s : stages) {
+        rk4_stage(stencil, psi, s, 0, stencil.getNx());
     }
+}
 
-    return result;
+void Schrodinger::RK4_inplace(const Stencil& stencil, SplitField& psi, ThreadPool& pool) const {
+    if (split_next.re.size() != psi.re.size()) {
+        split_next = stencil.field();
+    }
+    if (split_rings.size() != static_cast<size_t>(pool.size()) ||
+        split_rings[0].re.size() != static_cast<size_t>(RING_ROWS) * stencil.getStride()) {
+        SplitField ring;
+        ring.re.assign(static_cast<size_t>(RING_ROWS) * stencil.getStride(), 0.0);
+        ring.im = ring.re;
+        split_rings.assign(pool.size(), ring);
+    }
+
+    // Bands overlap their neighbours' inputs, so the step goes to a second buffer
+    int nx = stencil.getNx();
+    int band = max(MIN_BAND, (nx + 4 * pool.size() - 1) / (4 * pool.size()));
+    pool.parallel_for(nx, band, [&](int begin, int end, int worker) {
+        rk4_band(stencil, psi, split_next, split_rings[worker], dt, begin, end);
+    });
+    swap(psi.re, split_next.re);
+    swap(psi.im, split_next.im);
+}
+
+// --- Chebyshev propagator ---
+
+void Schrodinger::hamiltonian_bounds(const Stencil& stencil, double& lower, double& upper) const {
+    // H = -1/2 Lap, so the stencil's bounds halve
+    lower = 0.5 * stencil.getLower();
+    upper = 0.5 * stencil.getUpper();
+}
+
+// J_0(x) .. J_n(x) for x >= 0 by Miller's backward recurrence, normalised with
+// J_0 + 2 (J_2 + J_4 + ...) = 1
+static vector<double> bessel_j(int n, double x) {
+    vector<double> J(n + 1, 0.0);
+    if (x == 0) {
+        J[0] = 1;
+        return J;
+    }
+    int top = max(n, static_cast<int>(x)) + 32 + static_cast<int>(sqrt(60.0 * max(n, static_cast<int>(x) + 1)));
+    top += top % 2;
+    double next = 0, current = 1e-300, norm = 0;
+    for (int k = top; k > 0; k--) {
+        double previous = 2 * k / x * current - next;
+        next = current;
+        current = previous;
+        if (k - 1 <= n) J[k - 1] = current;
+        if ((k - 1) % 2 == 0) norm += (k - 1 == 0 ? 1 : 2) * current;
+        if (abs(current) > 1e250) {
+            // Rescale everything so far to keep the recurrence in range
+            next *= 1e-250;
+            current *= 1e-250;
+            norm *= 1e-250;
+            for (int m = k - 1; m <= n; m++) J[m] *= 1e-250;
+        }
+    }
+    for (double& v : J) v /= norm;
+    return J;
+}
+
+int Schrodinger::Chebyshev_order(double width, double t, double tolerance) {
+    // 2 |J_k(x)| bounds term k, and past k = x the J_k fall off faster than geometrically
+    double x = abs(width * t) / 2;
+    int n = static_cast<int>(x) + 16;
+    while (true) {
+        vector<double> J = bessel_j(n, x);
+        double tail = 0;
+        for (int k = n; k > 0; k--) {
+            tail += 2 * abs(J[k]);
+            if (tail >= tolerance) {
+                if (k < n - 8) return k;
+                break;
+            }
+        }
+        if (tail < tolerance) return 0;
+        n *= 2;
+    }
+}
+
+// One Chebyshev term over a row: T = p (H - a) cur - prev, written over prev, and acc
+// gains coefficient * T. The first term has no prev and sets acc = c0 * cur + c1 * T.
+template <bool FIRST>
+static void chebyshev_row(const double* __restrict cur_re, const double* __restrict cur_im,
+                          const double* __restrict m,
+                          double* __restrict prev_re, double* __restrict prev_im,
+                          double* __restrict acc_re, double* __restrict acc_im,
+                          int n, int stride, double dh_sq, double p, double a,
+                          complex<double> c0, complex<double> c) {
+    double c0r = c0.real(), c0i = c0.imag(), cr = c.real(), ci = c.imag();
+    for (int j = 0; j < n; j++) {
+        double lap_re = Stencil::laplacian_at(cur_re[j - stride], cur_re[j + stride], cur_re[j + 1], cur_re[j - 1], cur_re[j], dh_sq);
+        double lap_im = Stencil::laplacian_at(cur_im[j - stride], cur_im[j + stride], cur_im[j + 1], cur_im[j - 1], cur_im[j], dh_sq);
+        double t_re = m[j] * (p * (-0.5 * lap_re - a * cur_re[j]));
+        double t_im = m[j] * (p * (-0.5 * lap_im - a * cur_im[j]));
+        if (FIRST) {
+            acc_re[j] = c0r * cur_re[j] - c0i * cur_im[j] + cr * t_re - ci * t_im;
+            acc_im[j] = c0r * cur_im[j] + c0i * cur_re[j] + cr * t_im + ci * t_re;
+        } else {
+            t_re -= prev_re[j];
+            t_im -= prev_im[j];
+            acc_re[j] += cr * t_re - ci * t_im;
+            acc_im[j] += cr * t_im + ci * t_re;
+        }
+        prev_re[j] = t_re;
+        prev_im[j] = t_im;
+    }
+}
+
+int Schrodinger::Chebyshev_inplace(const Stencil& stencil, SplitField& psi, double t, double tolerance,
+                                   ThreadPool& pool) const {
+    if (split_acc.re.size() != psi.re.size()) {
+        split_acc = split_stage[0] = split_stage[1] = stencil.field();
+    }
+
+    // exp(i H t) with H = a + b Hn, Hn's spectrum inside [-1, 1]:
+    // exp(i a t) sum_k (2 - [k = 0]) (i sign t)^k J_k(b |t|) T_k(Hn)
+    double lower, upper;
+    hamiltonian_bounds(stencil, lower, upper);
+    double a = (upper + lower) / 2, b = (upper - lower) / 2;
+    int order = max(1, Chebyshev_order(upper - lower, t, tolerance));
+    vector<double> J = bessel_j(order, b * abs(t));
+    vector<complex<double>> coefficients(order + 1);
+    complex<double> turn(0, t < 0 ? -1 : 1), power = exp(complex<double>(0, a * t));
+    for (int k = 0; k <= order; k++) {
+        coefficients[k] = (k == 0 ? 1.0 : 2.0) * J[k] * power;
+        power *= turn;
+    }
+    if (b == 0) {
+        // A single level: just the phase, which the first term carries on its own
+        for (int k = 1; k <= order; k++) coefficients[k] = 0;
+        b = 1;
+    }
+
+    // T_0 is psi itself and T_1 goes to the scratch plane; from then on each term is
+    // written over the one two back, so psi and the scratch take turns
+    int nx = stencil.getNx(), ny = stencil.getNy(), stride = stencil.getStride();
+    double dh_sq = stencil.getDh() * stencil.getDh();
+    const double* mask = stencil.getMask().data();
+    SplitField* terms[2] = {&psi, &split_stage[0]};
+    int band = max(1, (nx + 4 * pool.size() - 1) / (4 * pool.size()));
+    for (int k = 1; k <= order; k++) {
+        const SplitField& cur = *terms[(k - 1) % 2];
+        SplitField& prev = *terms[k % 2];
+        pool.parallel_for(nx, band, [&](int begin, int end, int) {
+            for (int i = begin; i < end; i++) {
+                int row = stencil.index(i, 0);
+                if (k == 1) {
+                    chebyshev_row<true>(cur.re.data() + row, cur.im.data() + row, mask + row,
+                                        prev.re.data() + row, prev.im.data() + row,
+                                        split_acc.re.data() + row, split_acc.im.data() + row,
+                                        ny, stride, dh_sq, 1 / b, a, coefficients[0], coefficients[1]);
+                } else {
+                    chebyshev_row<false>(cur.re.data() + row, cur.im.data() + row, mask + row,
+                                         prev.re.data() + row, prev.im.data() + row,
+                                         split_acc.re.data() + row, split_acc.im.data() + row,
+                                         ny, stride, dh_sq, 2 / b, a, coefficients[0], coefficients[k]);
+                }
+            }
+        });
+    }
+    swap(psi.re, split_acc.re);
+    swap(psi.im, split_acc.im);
+    return order;
+}
+
+int Schrodinger::Chebyshev_inplace(const Stencil& stencil, SplitField& psi, double t, double tolerance) const {
+    ThreadPool pool(1);
+    return Chebyshev_inplace(stencil, psi, t, tolerance, pool);
 }
 
 void Schrodinger::add_scaled_inplace(vector<complex<double>>& result,
@@ -157,7 +461,3 @@ vector<complex<double>> Schrodinger::gaussian_packet(
 
     return psi;
 }
-
-void EigenVectors() {
-    Eigen::Matrix2cd M = Eigen::Matrix2cd::Identity();
-}
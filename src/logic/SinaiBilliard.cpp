@@ -5,61 +5,122 @@
 #include <cmath>
 #include <vector>
 #include <algorithm>
+#ifndef BILLIARDS_HEADLESS
 #include <raylib.h>
+#endif
 
 using namespace std;
 
 SinaiBilliard::SinaiBilliard(double a, double b, double l, double h)
-    : outer(a, b, l, h) {}
+    : SinaiBilliard(Billiard(a, b, l, h)) {}
+
+SinaiBilliard::SinaiBilliard(const Billiard& outer)
+    : outer(outer),
+      grid(make_shared<ScattererGrid>(outer.getLower(), outer.getUpper())) {}
+
+// Getters
+const Billiard& SinaiBilliard::getOuter() const {
+    return outer;
+}
+const vector<Circle>& SinaiBilliard::getScatterers() const {
+    return inner;
+}
+shared_ptr<const ScattererGrid> SinaiBilliard::getGrid() const {
+    return grid;
+}
 
 void SinaiBilliard::addScatterer(Vec2 center, double radius) {
+    offsets.push_back(getPerimeter());
     inner.push_back({center, radius});
+    if (grid.use_count() > 1) grid = make_shared<ScattererGrid>(*grid); // copy on write
+    grid->insert(inner, static_cast<int>(inner.size()) - 1);
+}
+
+void SinaiBilliard::addScatterers(const vector<Circle>& circles) {
+    for (const auto& c : circles) {
+        offsets.push_back(getPerimeter());
+        inner.push_back(c);
+    }
+    if (grid.use_count() > 1) grid = make_shared<ScattererGrid>(*grid);
+    grid->rebuild(inner);
 }
 
 Vec2 SinaiBilliard::getIntersectionPoint(Vec2 p, Vec2 d) const {
+    return intersect(p, d).point;
+}
+
+Hit SinaiBilliard::intersect(Vec2 p, Vec2 d, int from) const {
     d = d.normalize();
-    double t_best = numeric_limits<double>::infinity();
-    Vec2 bestHit;
 
     // --- Outer boundary ---
+    Hit hit = outer.intersect(p, d);
+    double t_max = hit.surface >= 0 ? hit.t : numeric_limits<double>::infinity();
 
-
-    Vec2 candidate = outer.getIntersectionPointHelper(p, d);
-
-    if (candidate != p) {
-        double t = (candidate - p).mag();
-        if (t > 1e-9 && t < t_best) {
-            t_best = t;
-            bestHit = candidate;
-        }
+    // --- Scatterers in front of it ---
+    double t;
+    int base = outer.getSurfaces();
+    int k = grid->intersect(inner, p, d, t_max, from - base, t);
+    if (k >= 0) {
+        hit.surface = base + k;
+        hit.t = t;
+        hit.point = p + d * t;
+        hit.normal = (hit.point - inner[k].center).normalize();
     }
+    return hit;
+}
+
+Vec2 SinaiBilliard::getNormal(int surface, Vec2 p) const {
+    int base = outer.getSurfaces();
+    if (surface < base) return outer.getNormal(surface, p);
+    const Circle& c = inner[surface - base];
+    return (p - c.center).normalize();
+}
 
+double SinaiBilliard::getCurvature(int surface, Vec2 p) const {
+    int base = outer.getSurfaces();
+    if (surface < base) return outer.getCurvature(surface, p);
+    return 1 / inner[surface - base].radius;
+}
 
-    // --- All scatterers ---
+bool SinaiBilliard::contains(Vec2 p) const {
+    if (!outer.contains(p)) return false;
     for (const auto& c : inner) {
-        Vec2 f = p - c.center;
-        double A = d.dot(d);
-        double B = 2 * f.dot(d);
-        double C = f.dot(f) - c.radius * c.radius;
-        double disc = B * B - 4 * A * C;
-
-        if (disc >= 0) {
-            double sqrtD = sqrt(disc);
-            double t1 = (-B - sqrtD) / (2 * A);
-            double t2 = (-B + sqrtD) / (2 * A);
-
-            if (t1 > 1e-9 && t1 < t_best) {
-                t_best = t1;
-                bestHit = p + d * t1;
-            }
-            if (t2 > 1e-9 && t2 < t_best) {
-                t_best = t2;
-                bestHit = p + d * t2;
-            }
-        }
+        if ((p - c.center).mag() <= c.radius) return false;
     }
+    return true;
+}
 
-    return bestHit;
+double SinaiBilliard::getPerimeter() const {
+    if (inner.empty()) return outer.getPerimeter();
+    return offsets.back() + 2 * M_PI * inner.back().radius;
+}
+
+double SinaiBilliard::getArcLength(int surface, Vec2 p) const {
+    int base = outer.getSurfaces();
+    if (surface < base) return outer.getArcLength(surface, p);
+
+    int k = surface - base;
+    double angle = atan2(p.y - inner[k].center.y, p.x - inner[k].center.x);
+    if (angle < 0) angle += 2 * M_PI;
+    return offsets[k] + inner[k].radius * angle;
+}
+
+Vec2 SinaiBilliard::getPoint(double s, int& surface) const {
+    double perimeter = getPerimeter();
+    s = fmod(s, perimeter);
+    if (s < 0) s += perimeter;
+    if (inner.empty() || s < offsets.front()) return outer.getPoint(s, surface);
+
+    int k = static_cast<int>(upper_bound(offsets.begin(), offsets.end(), s) - offsets.begin()) - 1;
+    const Circle& c = inner[k];
+    double angle = (s - offsets[k]) / c.radius;
+    surface = outer.getSurfaces() + k;
+    return c.center + Vec2(cos(angle), sin(angle)) * c.radius;
+}
+
+Vec2 SinaiBilliard::getBirkhoff(int surface, Vec2 p, Vec2 d) const {
+    Vec2 n = getNormal(surface, p);
+    return {getArcLength(surface, p), d.dot(Vec2(-n.y, n.x))};
 }
 
 Vec2 SinaiBilliard::getNormal(Vec2 p) const {
@@ -133,6 +194,27 @@ vector<int> SinaiBilliard::getBoundary(double width, double height, double dh) c
         }
     };
 
+    // General edge lists, sampled at half-cell spacing
+    if (outer.getShape() == Billiard::EDGES) {
+        auto set_point = [&](Vec2 q) {
+            set_pixel(static_cast<int>(round(cx + q.x / dh)), static_cast<int>(round(cy + q.y / dh)));
+        };
+        for (const auto& e : outer.getEdges()) {
+            if (e.degenerate()) continue;
+            if (!e.arc) {
+                int steps = max(1, static_cast<int>(ceil(2 * (e.p1 - e.p0).mag() / dh)));
+                for (int k = 0; k <= steps; k++) {
+                    set_point(e.p0 + (e.p1 - e.p0) * (static_cast<double>(k) / steps));
+                }
+            } else {
+                int steps = max(1, static_cast<int>(ceil(2 * abs(e.sweep) * max(e.rx, e.ry) / dh)));
+                for (int k = 0; k <= steps; k++) {
+                    set_point(e.pointAt(e.start + e.sweep * k / steps));
+                }
+            }
+        }
+    }
+
     // Rounded corners
     if (outer.getA() != 0 || outer.getB() != 0) {
         double step = M_PI / (8.0 * max(ax, by));
@@ -174,11 +256,13 @@ vector<int> SinaiBilliard::getBoundary(double width, double height, double dh) c
     return boundary; // flattened n*m grid
 }
 
+#ifndef BILLIARDS_HEADLESS
 void SinaiBilliard::draw(double cx, double cy) const{
     outer.draw(cx, cy);
     for (auto [c, r] : inner) {
         DrawCircleLines(cx - c.x, cy - c.y, r, WHITE);
     }
 }
+#endif
 
 
@@ -1,26 +1,51 @@
 #ifndef SINAIBILLIARD_H
 #define SINAIBILLIARD_H
 #include "Billiard.h"
+#include "ScattererGrid.h"
 #include "Vec2.h"
+#include <memory>
 #include <vector>
 
 
-struct Circle {
-    Vec2 center;
-    double radius;
-};
-
 class SinaiBilliard {
 private:
     Billiard outer;              // Outer boundary
     std::vector<Circle> inner;   // Inner scatterers
+    std::shared_ptr<ScattererGrid> grid; // Acceleration grid over inner, shared between copies
+    std::vector<double> offsets;  // arc length at the start of each scatterer, after the outer boundary
 public:
     SinaiBilliard(double a, double b, double l, double h);
+    explicit SinaiBilliard(const Billiard& outer);
+
+    // Getters
+    const Billiard& getOuter() const;
+    const std::vector<Circle>& getScatterers() const;
+    std::shared_ptr<const ScattererGrid> getGrid() const;
+
     void addScatterer(Vec2 center, double radius);
+    void addScatterers(const std::vector<Circle>& circles);
     Vec2 getIntersectionPoint(Vec2 p, Vec2 d) const;
     Vec2 getNormal(Vec2 p) const;
+
+    // Surface ids: the outer boundary's, then outer.getSurfaces() + k for scatterer k.
+    // `from` is the surface the ray starts on; a convex scatterer cannot be hit again right away.
+    Hit intersect(Vec2 p, Vec2 d, int from = -1) const;
+    Vec2 getNormal(int surface, Vec2 p) const;
+    // Boundary curvature seen from inside the table: > 0 on scatterers, < 0 on focusing outer arcs
+    double getCurvature(int surface, Vec2 p) const;
+    // Inside the outer boundary and outside every scatterer
+    bool contains(Vec2 p) const;
+
+    // Birkhoff coordinates: arc length s runs over the outer boundary, then around each
+    // scatterer, counter-clockwise on every component; p is the tangential component of d
+    double getPerimeter() const;
+    double getArcLength(int surface, Vec2 p) const;
+    Vec2 getPoint(double s, int& surface) const; // boundary point at arc length s (modulo the perimeter)
+    Vec2 getBirkhoff(int surface, Vec2 p, Vec2 d) const;
     vector<int> getBoundary(double width, double height, double dh) const;
+#ifndef BILLIARDS_HEADLESS
     void draw(double cx, double cy) const;
+#endif
 };
 
 
@@ -0,0 +1,100 @@
+#include "SplitOperator.h"
+#include <cmath>
+#include <unsupported/Eigen/FFT>
+#include "ThreadPool.h"
+#include "Utils.h"
+
+using namespace std;
+
+struct SplitOperator::Worker {
+    Eigen::FFT<double> fft;
+    vector<complex<double>> in, out;
+};
+
+SplitOperator::SplitOperator(int nx, int ny, double dh, double dt, const vector<int>& boundary, double wall)
+    : nx(nx), ny(ny), dh(dh), dt(dt), wall(wall > 0 ? wall : defaultWall(dh)),
+      potential(nx * ny), kinetic(nx * ny) {
+    complex<double> wallPhase = exp(complex<double>(0, 0.5 * this->wall * dt));
+    for (int c = 0; c < nx * ny; c++) {
+        potential[c] = boundary[c] == 1 ? wallPhase : complex<double>(1, 0);
+    }
+
+    // -1/2 of the five-point Laplacian is diagonal in Fourier space with
+    // T = 2 / dh^2 (sin^2(pi p / nx) + sin^2(pi q / ny)) on mode (p, q)
+    vector<double> sx(nx), sy(ny);
+    for (int p = 0; p < nx; p++) sx[p] = pow(sin(M_PI * p / nx), 2);
+    for (int q = 0; q < ny; q++) sy[q] = pow(sin(M_PI * q / ny), 2);
+    for (int p = 0; p < nx; p++) {
+        for (int q = 0; q < ny; q++) {
+            double T = 2 / (dh * dh) * (sx[p] + sy[q]);
+            kinetic[idx(p, q, ny)] = exp(complex<double>(0, T * dt));
+        }
+    }
+}
+
+SplitOperator::~SplitOperator() = default;
+
+void SplitOperator::transform(vector<complex<double>>& psi, bool inverse, ThreadPool& pool) {
+    while (static_cast<int>(workers.size()) < pool.size()) {
+        workers.emplace_back(new Worker());
+        workers.back()->in.resize(max(nx, ny));
+        workers.back()->out.resize(max(nx, ny));
+    }
+
+    // Rows are contiguous and transform in place through the worker's line
+    pool.parallel_for(nx, max(1, nx / (4 * pool.size())), [&](int begin, int end, int w) {
+        Worker& worker = *workers[w];
+        for (int i = begin; i < end; i++) {
+            complex<double>* row = psi.data() + idx(i, 0, ny);
+            if (inverse) worker.fft.inv(worker.out.data(), row, ny);
+            else worker.fft.fwd(worker.out.data(), row, ny);
+            copy(worker.out.begin(), worker.out.begin() + ny, row);
+        }
+    });
+    // Columns are gathered into the line first
+    pool.parallel_for(ny, max(1, ny / (4 * pool.size())), [&](int begin, int end, int w) {
+        Worker& worker = *workers[w];
+        for (int j = begin; j < end; j++) {
+            for (int i = 0; i < nx; i++) worker.in[i] = psi[idx(i, j, ny)];
+            if (inverse) worker.fft.inv(worker.out.data(), worker.in.data(), nx);
+            else worker.fft.fwd(worker.out.data(), worker.in.data(), nx);
+            for (int i = 0; i < nx; i++) psi[idx(i, j, ny)] = worker.out[i];
+        }
+    });
+}
+
+void SplitOperator::step(vector<complex<double>>& psi, ThreadPool& pool) {
+    int size = nx * ny;
+    for (int c = 0; c < size; c++) psi[c] *= potential[c];
+    transform(psi, false, pool);
+    for (int c = 0; c < size; c++) psi[c] *= kinetic[c];
+    transform(psi, true, pool);
+    for (int c = 0; c < size; c++) psi[c] *= potential[c];
+}
+
+void SplitOperator::step(vector<complex<double>>& psi) {
+    ThreadPool pool(1);
+    step(psi, pool);
+}
+
+double SplitOperator::defaultWall(double dh) {
+    return WALL_FACTOR * 4 / (dh * dh);
+}
+
+int SplitOperator::steps(double duration, double wall) {
+    return max(1, static_cast<int>(ceil(abs(duration) * wall / MAX_WALL_PHASE)));
+}
+
+// Getters
+int SplitOperator::getNx() const {
+    return nx;
+}
+int SplitOperator::getNy() const {
+    return ny;
+}
+double SplitOperator::getDt() const {
+    return dt;
+}
+double SplitOperator::getWall() const {
+    return wall;
+}
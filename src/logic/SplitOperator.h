@@ -0,0 +1,62 @@
+#ifndef SPLITOPERATOR_H
+#define SPLITOPERATOR_H
+
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+class ThreadPool;
+
+// Strang split-operator propagator for H = -1/2 Lap + V on the quantum grid: half a step
+// of the potential, a full kinetic step in Fourier space, another half step of the
+// potential. Time runs with the sign RK4_Schrodinger uses (dpsi/dt = -i/2 Lap psi), so
+// both engines move a packet the same way. The kinetic phase uses the symbol of the
+// five-point Laplacian rather than k^2, so away from walls this is the same discrete
+// equation as the RK4 stepper.
+//
+// Every factor is a pure phase, so the step is unitary and stable for any dt. Walls from
+// getBoundary are a potential barrier `wall` high, though, and the split only resolves
+// the reflection off it while wall * dt stays below about pi; beyond that the barrier
+// turns into a phase screen the packet leaks through. steps() gives the step count that
+// keeps to that bound. The grid is periodic, which the walls around the table hide.
+class SplitOperator {
+private:
+    struct Worker; // FFT plans and a line of scratch, one per pool worker
+
+    int nx, ny;
+    double dh, dt, wall;
+    vector<complex<double>> potential; // exp(i V dt / 2) per cell
+    vector<complex<double>> kinetic;   // exp(i T dt) per Fourier mode, same layout as psi
+    vector<unique_ptr<Worker>> workers;
+
+    void transform(vector<complex<double>>& psi, bool inverse, ThreadPool& pool);
+
+public:
+    static constexpr double WALL_FACTOR = 4;         // default wall height over the grid's top kinetic energy
+    static constexpr double MAX_WALL_PHASE = M_PI;   // largest wall * dt that still reflects cleanly
+
+    // boundary is the nx x ny wall map from Billiard::getBoundary (1 = wall); wall <= 0
+    // uses defaultWall(dh)
+    SplitOperator(int nx, int ny, double dh, double dt, const vector<int>& boundary, double wall = 0);
+    ~SplitOperator();
+
+    // Advances psi (nx * ny, x-major) by dt in place
+    void step(vector<complex<double>>& psi, ThreadPool& pool);
+    void step(vector<complex<double>>& psi);
+
+    // WALL_FACTOR times the largest kinetic energy the grid holds, 4 / dh^2
+    static double defaultWall(double dh);
+    // Fewest equal steps covering `duration` with wall * dt <= MAX_WALL_PHASE
+    static int steps(double duration, double wall);
+
+    // Getters
+    int getNx() const;
+    int getNy() const;
+    double getDt() const;
+    double getWall() const;
+};
+
+#endif //SPLITOPERATOR_H
@@ -0,0 +1,105 @@
+#include "Stencil.h"
+#include "Utils.h"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+static const int LINE = 8; // doubles per 64-byte cache line
+
+Stencil::Stencil(int nx, int ny, double dh, const vector<int>& boundary)
+    : nx(nx), ny(ny), stride((ny + 2 + LINE - 1) / LINE * LINE), dh(dh),
+      mask(static_cast<size_t>(nx + 2) * stride, 0.0), lower(0), upper(0) {
+    for (int i = 0; i < nx; i++) {
+        for (int j = 0; j < ny; j++) {
+            mask[index(i, j)] = boundary[idx(i, j, ny)] == 1 ? 0.0 : 1.0;
+        }
+    }
+
+    // Gershgorin discs: centre 4 / dh^2, radius 1 / dh^2 per open neighbour
+    double dh_sq = dh * dh;
+    lower = numeric_limits<double>::infinity();
+    for (int i = 0; i < nx; i++) {
+        for (int j = 0; j < ny; j++) {
+            int c = index(i, j);
+            if (mask[c] == 0) continue;
+            double radius = (mask[c - stride] + mask[c + stride] + mask[c - 1] + mask[c + 1]) / dh_sq;
+            lower = min(lower, 4 / dh_sq - radius);
+            upper = max(upper, 4 / dh_sq + radius);
+        }
+    }
+    // -Lap with Dirichlet walls is positive, whatever the discs say
+    lower = lower > upper ? 0 : max(0.0, lower);
+}
+
+SplitField Stencil::field() const {
+    SplitField f;
+    f.re.assign(mask.size(), 0.0);
+    f.im.assign(mask.size(), 0.0);
+    return f;
+}
+
+void Stencil::load(const vector<complex<double>>& psi, SplitField& f) const {
+    if (f.re.size() != mask.size()) f = field();
+    for (int i = 0; i < nx; i++) {
+        const complex<double>* src = psi.data() + idx(i, 0, ny);
+        double* re = f.re.data() + index(i, 0);
+        double* im = f.im.data() + index(i, 0);
+        const double* m = mask.data() + index(i, 0);
+        for (int j = 0; j < ny; j++) {
+            re[j] = m[j] * src[j].real();
+            im[j] = m[j] * src[j].imag();
+        }
+    }
+}
+
+void Stencil::store(const SplitField& f, vector<complex<double>>& psi) const {
+    for (int i = 0; i < nx; i++) {
+        for (int j = 0; j < ny; j++) {
+            int c = index(i, j);
+            if (mask[c] != 0) psi[idx(i, j, ny)] = {f.re[c], f.im[c]};
+        }
+    }
+}
+
+// One row of one plane
+static void sweep(const double* c, double* r, const double* m, int n, int stride, double dh_sq) {
+    for (int j = 0; j < n; j++) {
+        r[j] = m[j] * Stencil::laplacian_at(c[j - stride], c[j + stride], c[j + 1], c[j - 1], c[j], dh_sq);
+    }
+}
+
+void Stencil::laplacian(const SplitField& in, SplitField& out) const {
+    double dh_sq = dh * dh;
+    for (int i = 0; i < nx; i++) {
+        int row = index(i, 0);
+        sweep(in.re.data() + row, out.re.data() + row, mask.data() + row, ny, stride, dh_sq);
+        sweep(in.im.data() + row, out.im.data() + row, mask.data() + row, ny, stride, dh_sq);
+    }
+}
+
+// Getters
+int Stencil::getNx() const {
+    return nx;
+}
+int Stencil::getNy() const {
+    return ny;
+}
+int Stencil::getStride() const {
+    return stride;
+}
+int Stencil::getSize() const {
+    return static_cast<int>(mask.size());
+}
+double Stencil::getDh() const {
+    return dh;
+}
+const vector<double>& Stencil::getMask() const {
+    return mask;
+}
+double Stencil::getLower() const {
+    return lower;
+}
+double Stencil::getUpper() const {
+    return upper;
+}
@@ -0,0 +1,64 @@
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include <complex>
+#include <vector>
+
+using namespace std;
+
+// Complex grid function stored as separate real and imaginary planes, each with a ring
+// of ghost cells around the nx x ny interior. Rows run along y like the quantum grid,
+// so interior cell (i, j) is at (i + 1) * stride + j + 1.
+struct SplitField {
+    vector<double> re, im;
+};
+
+// Five-point Laplacian with Dirichlet walls on a ghost-padded grid. Walls and ghosts
+// are zeros of a precomputed mask: fields keep them at zero and every result is
+// multiplied by the mask, so the sweep has no branches and vectorises over a row.
+class Stencil {
+private:
+    int nx, ny;
+    int stride;          // padded row length, ny + 2 rounded up to whole cache lines
+    double dh;
+    vector<double> mask; // 1 on open interior cells, 0 on walls and ghosts
+    double lower, upper; // Gershgorin bounds on the spectrum of -Lap over the open cells
+
+public:
+    // boundary is the nx x ny wall map from Billiard::getBoundary (1 = wall)
+    Stencil(int nx, int ny, double dh, const vector<int>& boundary);
+
+    // A zeroed field of the padded shape
+    SplitField field() const;
+    // psi (nx * ny, x-major) into f; wall cells are zeroed
+    void load(const vector<complex<double>>& psi, SplitField& f) const;
+    // Open cells of f back into psi; wall cells of psi are left as they are
+    void store(const SplitField& f, vector<complex<double>>& psi) const;
+
+    // out = Laplacian of in, zero on walls. in must be zero on walls and ghosts.
+    void laplacian(const SplitField& in, SplitField& out) const;
+
+    // Five-point Laplacian of one cell from its neighbours along x (left, right) and y
+    // (up, down). Every sweep, split or complex, fused or not, goes through here so they
+    // all sum in one order. It takes values rather than a pointer so the loads stay on the
+    // callers' __restrict planes, which the vectoriser needs.
+    template <class T>
+    static T laplacian_at(T left, T right, T up, T down, T centre, double dh_sq) {
+        return (left + right + up + down - 4.0 * centre) / dh_sq;
+    }
+
+    // Padded index of interior cell (i, j)
+    int index(int i, int j) const { return (i + 1) * stride + j + 1; }
+
+    // Getters
+    int getNx() const;
+    int getNy() const;
+    int getStride() const;
+    int getSize() const;     // padded cells per plane
+    double getDh() const;
+    const vector<double>& getMask() const;
+    double getLower() const; // spectrum bounds of -Lap, found once at construction
+    double getUpper() const;
+};
+
+#endif //STENCIL_H
@@ -0,0 +1,89 @@
+#include "TimeIndex.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+TimeIndex::TimeIndex(const vector<Vec2>& trajectory, double speed)
+    : owned(2 * trajectory.size()), xy(nullptr), points(static_cast<int>(trajectory.size())), speed(speed) {
+    for (int k = 0; k < points; k++) {
+        owned[2 * k] = trajectory[k].x;
+        owned[2 * k + 1] = trajectory[k].y;
+    }
+
+    times.assign(points, 0.0);
+    for (int k = 1; k < points; k++) {
+        times[k] = times[k - 1] + (point(k) - point(k - 1)).mag() / speed;
+    }
+}
+
+TimeIndex::TimeIndex(const double* xy, int points, double speed)
+    : xy(xy), points(points), speed(speed), times(points, 0.0) {
+    for (int k = 1; k < points; k++) {
+        times[k] = times[k - 1] + (point(k) - point(k - 1)).mag() / speed;
+    }
+}
+
+Vec2 TimeIndex::point(int k) const {
+    const double* data = xy ? xy : owned.data();
+    return {data[2 * k], data[2 * k + 1]};
+}
+
+TimeIndex::State TimeIndex::at(int k, double t) const {
+    // Past the end (or a single point): parked on the last point at rest
+    State state;
+    state.flight = k;
+    if (k + 1 >= points) {
+        state.position = points > 0 ? point(points - 1) : Vec2(0, 0);
+        state.velocity = Vec2(0, 0);
+        state.flight = max(0, points - 2);
+        return state;
+    }
+
+    Vec2 p0 = point(k), p1 = point(k + 1);
+    double span = times[k + 1] - times[k];
+    double u = span > 0 ? (t - times[k]) / span : 0;
+    state.position = p0 + (p1 - p0) * u;
+    state.velocity = span > 0 ? (p1 - p0) * (1 / span) : Vec2(0, 0);
+    return state;
+}
+
+TimeIndex::State TimeIndex::get(double t) const {
+    // Last point with times[k] <= t; zero-length flights share a time and are passed over
+    int k = static_cast<int>(upper_bound(times.begin(), times.end(), t) - times.begin()) - 1;
+    return at(max(0, k), max(t, 0.0));
+}
+
+Vec2 TimeIndex::getPosition(double t) const {
+    return get(t).position;
+}
+
+Vec2 TimeIndex::getVelocity(double t) const {
+    return get(t).velocity;
+}
+
+void TimeIndex::sample(double t0, double dt, int n, Vec2* positions, Vec2* velocities) const {
+    if (n <= 0) return;
+    int k = max(0, static_cast<int>(upper_bound(times.begin(), times.end(), t0) - times.begin()) - 1);
+    for (int s = 0; s < n; s++) {
+        double t = max(t0 + dt * s, 0.0);
+        while (k + 1 < points && times[k + 1] <= t) k++;
+        State state = at(k, t);
+        positions[s] = state.position;
+        if (velocities) velocities[s] = state.velocity;
+    }
+}
+
+// Getters
+int TimeIndex::getPoints() const {
+    return points;
+}
+double TimeIndex::getSpeed() const {
+    return speed;
+}
+double TimeIndex::getDuration() const {
+    return times.empty() ? 0 : times.back();
+}
+double TimeIndex::getTime(int k) const {
+    return times[k];
+}
@@ -0,0 +1,51 @@
+#ifndef TIMEINDEX_H
+#define TIMEINDEX_H
+
+#include <vector>
+#include "Vec2.h"
+
+using namespace std;
+
+// Physical-time view of one stored trajectory (its bounce points, starting with the
+// initial position). The particle moves at a constant speed, so the time of bounce k is
+// the prefix sum of the flight lengths before it divided by the speed; a query for time t
+// is a binary search in those sums. At a bounce the outgoing flight is reported, and
+// times past the last point stay on it with zero velocity.
+class TimeIndex {
+public:
+    struct State {
+        Vec2 position;
+        Vec2 velocity;
+        int flight;     // the flight from point `flight` to point `flight + 1`
+    };
+
+private:
+    vector<double> owned;   // interleaved x/y copy of the points when built from a vector
+    const double* xy;       // the points in place otherwise, nullptr when owned
+    int points;
+    double speed;
+    vector<double> times;   // time of each point, times[0] = 0
+
+    Vec2 point(int k) const;
+    State at(int k, double t) const;
+
+public:
+    explicit TimeIndex(const vector<Vec2>& trajectory, double speed = 1);
+    // Refers to xy in place (e.g. a mapped TrajectoryFile), which must outlive the index
+    TimeIndex(const double* xy, int points, double speed = 1);
+
+    State get(double t) const;
+    Vec2 getPosition(double t) const;
+    Vec2 getVelocity(double t) const;
+
+    // States at t0, t0 + dt, ..., n of them, in one forward walk instead of n searches
+    void sample(double t0, double dt, int n, Vec2* positions, Vec2* velocities = nullptr) const;
+
+    // Getters
+    int getPoints() const;
+    double getSpeed() const;
+    double getDuration() const;
+    double getTime(int k) const; // time of point k
+};
+
+#endif //TIMEINDEX_H
@@ -7,6 +7,8 @@
 #include <algorithm>
 #include "raylib.h"
 #include "writer/writer.h"
+#include "TimeIndex.h"
+#include "Profiler.h"
 using namespace std;
 
 const double epsilon = 1e-8;
@@ -17,27 +19,20 @@ bool start = false;
 bool quantum = false;
 
 double dh = 8;
+const double SPEED = 100;      // path length per frame
+const size_t MAX_TRAIL = 50000; // frames of trail kept per particle
 
 
-void draw_classical(vector<vector<Vec2>>& ALL_POINTS,
-                     vector<int>& indices,
-                     vector<int>& t,
-                     vector<vector<Vec2>>& all_trail,
-                     vector<double>& speed) {
+void draw_classical(const vector<TimeIndex>& timelines,
+                     double time,
+                     vector<vector<Vec2>>& all_trail) {
     int cx = WIDTH / 2;
     int cy = HEIGHT / 2;
-    for (size_t k = 0; k < ALL_POINTS.size(); ++k) {
-        int i = indices[k];
-        vector<Vec2>& POINTS = ALL_POINTS[k];
+    for (size_t k = 0; k < timelines.size(); ++k) {
         vector<Vec2>& trail = all_trail[k];
 
-        Vec2 p1 = POINTS[i];
-        Vec2 p0 = POINTS[i - 1];
-
-        double distance = sqrt((p1.x - p0.x)*(p1.x - p0.x) + (p1.y - p0.y)*(p1.y - p0.y));
-        int total_frames = max(1, static_cast<int>(distance / speed[k]));
-
-        Vec2 pos = move(i, t[k], POINTS, total_frames);
+        // Every particle at the same physical time, whatever the length of its flights
+        Vec2 pos = timelines[k].getPosition(time);
 
         trail.push_back(pos);
 
@@ -52,16 +47,8 @@ void draw_classical(vector<vector<Vec2>>& ALL_POINTS,
             DrawLine(start_x, start_y, end_x, end_y, WHITE);
         }
         // Optional: limit trail length
-        if (trail.size() > static_cast<size_t>(speed[k] * 500))
+        if (trail.size() > MAX_TRAIL)
             trail.erase(trail.begin());
-
-        if (start) t[k] += 1;
-
-        if (t[k] > total_frames) {
-            t[k] = 0;
-            indices[k] += 1;
-            speed[k] = min(speed[k] + 0.01, 200.0);
-        }
     }
 }
 
@@ -91,16 +78,17 @@ void windowVis(SinaiBilliard billiard, vector<vector<Vec2>>& ALL_POINTS, vector<
     SetTargetFPS(60);
 
     // Classical variables
-    vector<int> indices = vector<int>(ALL_POINTS.size(), 1);
-    vector<int> t = vector<int>(ALL_POINTS.size(), 0);
+    vector<TimeIndex> timelines;
+    for (const auto& points : ALL_POINTS) timelines.emplace_back(points);
+    double time = 0;
     vector<vector<Vec2>> all_trail = vector<vector<Vec2>>(ALL_POINTS.size(), vector<Vec2>());
-    vector<double> speed = vector<double>(ALL_POINTS.size(), 100.0);
 
     // Quantum variables
     int q = 0;
 
     // Main loop
     while (!WindowShouldClose()) {
+        PROFILE_SCOPE("render_frame");
         if (IsKeyPressed(KEY_Q)) {
             quantum = !quantum;
         }
@@ -111,10 +99,12 @@ void windowVis(SinaiBilliard billiard, vector<vector<Vec2>>& ALL_POINTS, vector<
         BeginDrawing();
         ClearBackground(BLACK);
 
-        if (!quantum)
-            draw_classical(ALL_POINTS, indices, t, all_trail, speed);
-        else
+        if (!quantum) {
+            draw_classical(timelines, time, all_trail);
+            if (start) time += SPEED;
+        } else {
             draw_quantum(QUANTUM_POINTS, q, dh);
+        }
         billiard.draw(WIDTH/2, HEIGHT/2);
 
         EndDrawing();
@@ -138,5 +128,6 @@ int main() {
     vector<vector<float>> data_quantum = write_quantum(dh, 3, 10, x0, y0, 100, angle, bill);
 
     windowVis(bill, data_classical, data_quantum);
+    PROFILE_REPORT(data_path("profile_report.json", "../../data/"));
     return 0;
 }
\ No newline at end of file
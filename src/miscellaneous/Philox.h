@@ -0,0 +1,68 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <array>
+#include <cstdint>
+
+using namespace std;
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy
+// as 1, 2, 3", SC 2011). Every call maps a 128-bit counter and a 64-bit key to 128 random
+// bits with no state in between, so sample i is the same whichever thread draws it and
+// in whatever order.
+class Philox {
+private:
+    static const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+    static const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+public:
+    using Block = array<uint32_t, 4>;
+
+    static Block generate(Block counter, uint64_t key) {
+        uint32_t k0 = static_cast<uint32_t>(key), k1 = static_cast<uint32_t>(key >> 32);
+        for (int round = 0; round < 10; round++) {
+            uint64_t p0 = static_cast<uint64_t>(M0) * counter[0];
+            uint64_t p1 = static_cast<uint64_t>(M1) * counter[2];
+            counter = {static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ k0, static_cast<uint32_t>(p1),
+                       static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ k1, static_cast<uint32_t>(p0)};
+            k0 += W0;
+            k1 += W1;
+        }
+        return counter;
+    }
+
+    // Counter from a 64-bit index and two 32-bit words (attempt number, stream, ...)
+    static Block generate(uint64_t index, uint32_t word2, uint32_t word3, uint64_t key) {
+        return generate({static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32), word2, word3}, key);
+    }
+
+    // Two doubles uniform in [0, 1) with 53 random bits each
+    static array<double, 2> uniform(const Block& bits) {
+        const double scale = 1.0 / 9007199254740992.0; // 2^-53
+        uint64_t a = (static_cast<uint64_t>(bits[0]) << 21) ^ (bits[1] >> 11);
+        uint64_t b = (static_cast<uint64_t>(bits[2]) << 21) ^ (bits[3] >> 11);
+        return {a * scale, b * scale};
+    }
+
+    // The three Random123 known-answer vectors for Philox4x32-10
+    static bool knownAnswers() {
+        struct Vector {
+            Block counter;
+            uint64_t key;
+            Block expected;
+        };
+        const Vector vectors[3] = {
+            {{0, 0, 0, 0}, 0, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+            {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, 0xffffffffffffffffull,
+             {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+            {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, 0x299f31d0a4093822ull,
+             {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+        };
+        for (const Vector& v : vectors) {
+            if (generate(v.counter, v.key) != v.expected) return false;
+        }
+        return true;
+    }
+};
+
+#endif //PHILOX_H
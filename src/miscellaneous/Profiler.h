@@ -0,0 +1,130 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Hot-path instrumentation, compiled in only with BILLIARDS_PROFILE defined.
+//   PROFILE_SCOPE("phase")               adds the wall time of the enclosing scope to a phase
+//   PROFILE_COUNT("phase", "counter", n) adds n to one of the phase's counters
+//   PROFILE_REPORT(path)                 writes every phase, its counters and their rates
+//                                        per second of phase time, plus peak memory, as JSON
+// Without BILLIARDS_PROFILE the macros expand to nothing and their arguments are never evaluated.
+// Scopes are meant for the calling thread; counters may be added from any thread.
+
+#ifdef BILLIARDS_PROFILE
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+class Profiler {
+private:
+    using clock = chrono::steady_clock;
+
+    struct Phase {
+        long long calls = 0;
+        double seconds = 0;
+        map<string, double> counters;
+    };
+
+    mutex m;
+    map<string, Phase> phases;
+    clock::time_point start = clock::now();
+
+    static long long peakMemory() {
+#if defined(__unix__) || defined(__APPLE__)
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return usage.ru_maxrss;        // bytes
+#else
+        return usage.ru_maxrss * 1024LL; // kilobytes
+#endif
+#else
+        return -1;
+#endif
+    }
+
+    static string number(double x) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.6g", x);
+        return buf;
+    }
+
+public:
+    static Profiler& get() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    void record(const string& phase, double seconds) {
+        lock_guard<mutex> lock(m);
+        Phase& p = phases[phase];
+        p.calls++;
+        p.seconds += seconds;
+    }
+
+    void count(const string& phase, const string& counter, double n) {
+        lock_guard<mutex> lock(m);
+        phases[phase].counters[counter] += n;
+    }
+
+    void report(const string& path) {
+        lock_guard<mutex> lock(m);
+        ofstream out(path);
+        out << "{\n";
+        out << "  \"wall_seconds\": " << number(chrono::duration<double>(clock::now() - start).count()) << ",\n";
+        out << "  \"peak_memory_bytes\": " << peakMemory() << ",\n";
+        out << "  \"phases\": {";
+        bool first = true;
+        for (const auto& kv : phases) {
+            const Phase& p = kv.second;
+            out << (first ? "\n" : ",\n");
+            first = false;
+            out << "    \"" << kv.first << "\": {\"calls\": " << p.calls << ", \"seconds\": " << number(p.seconds);
+            for (const auto& c : p.counters) {
+                out << ", \"" << c.first << "\": " << number(c.second);
+                if (p.seconds > 0) out << ", \"" << c.first << "_per_second\": " << number(c.second / p.seconds);
+            }
+            out << "}";
+        }
+        out << "\n  }\n}\n";
+    }
+
+    class Scope {
+    private:
+        const char* phase;
+        clock::time_point t0;
+
+    public:
+        explicit Scope(const char* phase) : phase(phase), t0(clock::now()) {}
+        ~Scope() {
+            Profiler::get().record(phase, chrono::duration<double>(clock::now() - t0).count());
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+};
+
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_(a, b)
+#define PROFILE_SCOPE(phase) Profiler::Scope PROFILE_JOIN(profile_scope_, __LINE__)(phase)
+#define PROFILE_COUNT(phase, counter, n) Profiler::get().count(phase, counter, static_cast<double>(n))
+#define PROFILE_REPORT(path) Profiler::get().report(path)
+
+#else
+
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_COUNT(phase, counter, n) ((void)0)
+#define PROFILE_REPORT(path) ((void)0)
+
+#endif // BILLIARDS_PROFILE
+
+#endif //PROFILER_H
@@ -0,0 +1,136 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Work-stealing thread pool.
+// parallel_for splits [0, n) into ranges that are dealt round-robin onto one
+// deque per worker. Each worker pops from the back of its own deque and, once
+// that is empty, steals from the front of the others. The calling thread acts
+// as worker 0, so a pool of size 1 runs everything inline.
+class ThreadPool {
+private:
+    struct Queue {
+        mutex m;
+        deque<pair<int, int>> ranges;
+    };
+
+    vector<thread> workers;
+    vector<unique_ptr<Queue>> queues;
+    const function<void(int, int, int)>* job = nullptr;
+
+    mutex m;
+    condition_variable wake, done;
+    int generation = 0;
+    int busy = 0;
+    bool stop = false;
+
+    bool pop(int w, pair<int, int>& range) {
+        {
+            Queue& own = *queues[w];
+            lock_guard<mutex> lock(own.m);
+            if (!own.ranges.empty()) {
+                range = own.ranges.back();
+                own.ranges.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            Queue& victim = *queues[(w + k) % queues.size()];
+            lock_guard<mutex> lock(victim.m);
+            if (!victim.ranges.empty()) {
+                range = victim.ranges.front();
+                victim.ranges.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void drain(int w) {
+        pair<int, int> range;
+        while (pop(w, range)) {
+            (*job)(range.first, range.second, w);
+        }
+    }
+
+    void run(int w) {
+        int seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> lock(m);
+                wake.wait(lock, [&] { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+            }
+            drain(w);
+            {
+                lock_guard<mutex> lock(m);
+                if (--busy == 0) done.notify_one();
+            }
+        }
+    }
+
+public:
+    // threads <= 0 uses every hardware thread
+    explicit ThreadPool(int threads = 0) {
+        if (threads <= 0) threads = max(1, static_cast<int>(thread::hardware_concurrency()));
+        for (int i = 0; i < threads; i++) queues.emplace_back(new Queue());
+        for (int i = 1; i < threads; i++) workers.emplace_back(&ThreadPool::run, this, i);
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(m);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const {
+        return static_cast<int>(queues.size());
+    }
+
+    // Calls fn(begin, end, worker) over [0, n) in ranges of at most `grain`
+    // and blocks until all of them are done. Not reentrant.
+    void parallel_for(int n, int grain, const function<void(int, int, int)>& fn) {
+        if (n <= 0) return;
+        grain = max(grain, 1);
+
+        int chunks = (n + grain - 1) / grain;
+        for (int c = 0; c < chunks; c++) {
+            Queue& q = *queues[c % size()];
+            lock_guard<mutex> lock(q.m);
+            q.ranges.emplace_back(c * grain, min(n, (c + 1) * grain));
+        }
+
+        {
+            lock_guard<mutex> lock(m);
+            job = &fn;
+            busy = size() - 1;
+            generation++;
+        }
+        wake.notify_all();
+        drain(0);
+
+        unique_lock<mutex> lock(m);
+        done.wait(lock, [&] { return busy == 0; });
+        job = nullptr;
+    }
+};
+
+#endif //THREADPOOL_H
@@ -4,13 +4,16 @@
 #include <complex>
 #include <vector>
 #include <cmath>
-#include "raylib.h"
 #include "Vec2.h"
+#ifndef BILLIARDS_HEADLESS
+#include "raylib.h"
+#endif
 
 inline int idx(int i, int j, int Ny) {
     return i * Ny + j;
 }
 
+#ifndef BILLIARDS_HEADLESS
 // Draw an elliptical arc (outline) using doubles
 inline void DrawEllipseArc(Vector2 center, double a, double b,
                     double startAngle, double endAngle,
@@ -59,4 +62,5 @@ inline void DrawFilledEllipseArc(Vector2 center, double a, double b,
         prev = curr;
     }
 }
+#endif // BILLIARDS_HEADLESS
 #endif
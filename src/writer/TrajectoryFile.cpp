@@ -0,0 +1,202 @@
+#include "TrajectoryFile.h"
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TRAJECTORY_MMAP 1
+#endif
+
+using namespace std;
+
+// --- Header serialisation ---
+
+static void put(vector<char>& out, const void* p, size_t n) {
+    out.insert(out.end(), static_cast<const char*>(p), static_cast<const char*>(p) + n);
+}
+template <typename T> static void put(vector<char>& out, T v) {
+    put(out, &v, sizeof(T));
+}
+
+template <typename T> static T get(const char* data, size_t bytes, size_t& at) {
+    if (at + sizeof(T) > bytes) throw runtime_error("trajectory file: truncated header");
+    T v;
+    memcpy(&v, data + at, sizeof(T));
+    at += sizeof(T);
+    return v;
+}
+
+static uint64_t align(uint64_t at) {
+    return (at + TrajectoryFormat::ALIGN - 1) / TrajectoryFormat::ALIGN * TrajectoryFormat::ALIGN;
+}
+
+// Everything before the index
+static vector<char> header(const SinaiBilliard& billiard, int particles, int points) {
+    const Billiard& outer = billiard.getOuter();
+    vector<char> out;
+    put(out, TrajectoryFormat::MAGIC, sizeof(TrajectoryFormat::MAGIC));
+    put<uint32_t>(out, TrajectoryFormat::VERSION);
+    put<int32_t>(out, particles);
+    put<int32_t>(out, points);
+
+    put<int32_t>(out, outer.getShape());
+    put<double>(out, outer.getA());
+    put<double>(out, outer.getB());
+    put<double>(out, outer.getL());
+    put<double>(out, outer.getH());
+    put<int32_t>(out, static_cast<int32_t>(outer.getEdges().size()));
+    for (const Edge& e : outer.getEdges()) {
+        put<int32_t>(out, e.arc);
+        for (double v : {e.p0.x, e.p0.y, e.p1.x, e.p1.y, e.center.x, e.center.y, e.rx, e.ry, e.start, e.sweep}) {
+            put<double>(out, v);
+        }
+    }
+
+    put<int32_t>(out, static_cast<int32_t>(billiard.getScatterers().size()));
+    for (const Circle& c : billiard.getScatterers()) {
+        put<double>(out, c.center.x);
+        put<double>(out, c.center.y);
+        put<double>(out, c.radius);
+    }
+    return out;
+}
+
+// --- Writer ---
+
+TrajectoryWriter::TrajectoryWriter(const string& path, const SinaiBilliard& billiard, int particles, int points)
+    : file(path, ios::binary), path(path), index(particles + 1), points(points) {
+    if (!file) throw runtime_error("trajectory file: cannot open " + path);
+    vector<char> head = header(billiard, particles, points);
+
+    // Every chunk has the same size, so the index is known before any data exists
+    uint64_t chunk = 2 * static_cast<uint64_t>(points) * sizeof(double);
+    head.resize((head.size() + 7) / 8 * 8, 0);
+    uint64_t at = align(head.size() + index.size() * sizeof(uint64_t));
+    for (int i = 0; i <= particles; i++) {
+        index[i] = at + i * chunk;
+    }
+    put(head, index.data(), index.size() * sizeof(uint64_t));
+    head.resize(index[0], 0);
+    file.write(head.data(), head.size());
+    if (!file) throw runtime_error("trajectory file: cannot write header to " + path);
+}
+
+void TrajectoryWriter::write(int first, int n, const double* xy) {
+    // Runs on pool workers, so a failure is left on the stream for finish() to report
+    lock_guard<mutex> lock(m);
+    if (!file) return;
+    file.seekp(static_cast<streamoff>(index[first]));
+    file.write(reinterpret_cast<const char*>(xy), 2 * static_cast<streamsize>(n) * points * sizeof(double));
+}
+
+void TrajectoryWriter::finish() {
+    file.flush();
+    if (!file) throw runtime_error("trajectory file: write failed for " + path);
+}
+
+uint64_t TrajectoryWriter::getSize() const {
+    return index.back();
+}
+
+// --- Reader ---
+
+TrajectoryFile::TrajectoryFile(const string& path) : billiard(0, 0, 0, 0) {
+#ifdef TRAJECTORY_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw runtime_error("trajectory file: cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data = static_cast<const char*>(p);
+            bytes = st.st_size;
+            mapped = true;
+        }
+    }
+    ::close(fd);
+#endif
+    if (!mapped) {
+        ifstream in(path, ios::binary);
+        if (!in) throw runtime_error("trajectory file: cannot open " + path);
+        buffer.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        data = buffer.data();
+        bytes = buffer.size();
+    }
+
+    size_t at = 0;
+    char magic[sizeof(TrajectoryFormat::MAGIC)];
+    for (char& c : magic) c = get<char>(data, bytes, at);
+    if (memcmp(magic, TrajectoryFormat::MAGIC, sizeof(magic)) != 0) {
+        throw runtime_error("trajectory file: bad magic in " + path);
+    }
+    if (get<uint32_t>(data, bytes, at) != TrajectoryFormat::VERSION) {
+        throw runtime_error("trajectory file: unsupported version in " + path);
+    }
+    particles = get<int32_t>(data, bytes, at);
+    points = get<int32_t>(data, bytes, at);
+
+    auto shape = static_cast<Billiard::Shape>(get<int32_t>(data, bytes, at));
+    double a = get<double>(data, bytes, at);
+    double b = get<double>(data, bytes, at);
+    double l = get<double>(data, bytes, at);
+    double h = get<double>(data, bytes, at);
+    vector<Edge> edges(get<int32_t>(data, bytes, at));
+    for (Edge& e : edges) {
+        e.arc = get<int32_t>(data, bytes, at) != 0;
+        for (double* v : {&e.p0.x, &e.p0.y, &e.p1.x, &e.p1.y, &e.center.x, &e.center.y, &e.rx, &e.ry, &e.start, &e.sweep}) {
+            *v = get<double>(data, bytes, at);
+        }
+    }
+    billiard = shape == Billiard::EDGES ? SinaiBilliard(Billiard(edges)) : SinaiBilliard(a, b, l, h);
+
+    vector<Circle> circles(get<int32_t>(data, bytes, at));
+    for (Circle& c : circles) {
+        c.center.x = get<double>(data, bytes, at);
+        c.center.y = get<double>(data, bytes, at);
+        c.radius = get<double>(data, bytes, at);
+    }
+    billiard.addScatterers(circles);
+
+    at = (at + 7) / 8 * 8;
+    if (particles < 0 || at + (particles + 1) * sizeof(uint64_t) > bytes) {
+        throw runtime_error("trajectory file: bad index in " + path);
+    }
+    index = reinterpret_cast<const uint64_t*>(data + at);
+    if (index[particles] > bytes) throw runtime_error("trajectory file: truncated data in " + path);
+}
+
+TrajectoryFile::~TrajectoryFile() {
+#ifdef TRAJECTORY_MMAP
+    if (mapped) munmap(const_cast<char*>(data), bytes);
+#endif
+}
+
+// Getters
+int TrajectoryFile::getParticles() const {
+    return particles;
+}
+int TrajectoryFile::getPoints() const {
+    return points;
+}
+const SinaiBilliard& TrajectoryFile::getBilliard() const {
+    return billiard;
+}
+bool TrajectoryFile::isMapped() const {
+    return mapped;
+}
+
+const double* TrajectoryFile::getTrajectory(int i) const {
+    return reinterpret_cast<const double*>(data + index[i]);
+}
+
+Vec2 TrajectoryFile::getPoint(int i, int t) const {
+    const double* xy = getTrajectory(i);
+    return {xy[2 * t], xy[2 * t + 1]};
+}
+
+TimeIndex TrajectoryFile::getTimeIndex(int i, double speed) const {
+    return TimeIndex(getTrajectory(i), points, speed);
+}
@@ -0,0 +1,78 @@
+#ifndef TRAJECTORYFILE_H
+#define TRAJECTORYFILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Vec2.h"
+#include "SinaiBilliard.h"
+#include "TimeIndex.h"
+
+using namespace std;
+
+// Self-describing classical trajectory container, particle-major so one particle is one
+// contiguous read. Layout, native byte order:
+//   header  magic, version, particles, points, the outer billiard (shape, a, b, l, h and
+//           its edge list) and the scatterers
+//   index   particles + 1 byte offsets of the chunks, the last one is the end of the file
+//   chunks  per particle, `points` interleaved x/y doubles starting at the initial point
+// The data starts on a 64-byte boundary, so a mapped file is read as doubles in place.
+namespace TrajectoryFormat {
+    const char MAGIC[8] = {'B', 'I', 'L', 'L', 'T', 'R', 'A', 'J'};
+    const uint32_t VERSION = 1;
+    const uint64_t ALIGN = 64;
+}
+
+class TrajectoryWriter {
+private:
+    ofstream file;
+    string path;
+    vector<uint64_t> index;
+    int points;
+    mutex m;
+
+public:
+    TrajectoryWriter(const string& path, const SinaiBilliard& billiard, int particles, int points);
+
+    // Chunks of particles [first, first + n), particle-major x/y, in a single write.
+    // Ranges may arrive in any order and from any thread.
+    void write(int first, int n, const double* xy);
+    void finish(); // flushes; throws if any write failed
+    uint64_t getSize() const; // final size of the file in bytes
+};
+
+class TrajectoryFile {
+private:
+    const char* data = nullptr;
+    size_t bytes = 0;
+    bool mapped = false;
+    vector<char> buffer;    // file contents when mmap is not available
+
+    int particles = 0, points = 0;
+    const uint64_t* index = nullptr;
+    SinaiBilliard billiard;
+
+public:
+    // Maps the file read-only where POSIX mmap exists, otherwise reads it into memory
+    explicit TrajectoryFile(const string& path);
+    ~TrajectoryFile();
+
+    TrajectoryFile(const TrajectoryFile&) = delete;
+    TrajectoryFile& operator=(const TrajectoryFile&) = delete;
+
+    // Getters
+    int getParticles() const;
+    int getPoints() const;
+    const SinaiBilliard& getBilliard() const;
+    bool isMapped() const;
+
+    // Interleaved x/y of particle i, straight out of the mapping: 2 * getPoints() doubles
+    const double* getTrajectory(int i) const;
+    Vec2 getPoint(int i, int t) const;
+    // Time queries on particle i, reading the mapping in place; valid while this file is open
+    TimeIndex getTimeIndex(int i, double speed = 1) const;
+};
+
+#endif //TRAJECTORYFILE_H
@@ -1,13 +1,44 @@
 #include <iostream>
 #include <cmath>
+#include <cstdio>
 #include "Vec2.h"
 #include <fstream>
+#include <sstream>
+#include <memory>
+#include <random>
 #include "SinaiBilliard.h"
 #include "Schrodinger.h"
 #include "Utils.h"
 #include <algorithm>
+#include <limits>
+#include <stdexcept>
+#ifndef BILLIARDS_HEADLESS
 #include "raylib.h"
+#endif
 #include "writer.h"
+#include "Ensemble.h"
+#include "Lyapunov.h"
+#include "Escape.h"
+#include "Occupation.h"
+#include "MagneticBilliard.h"
+#include "HardDiskGas.h"
+#include "SplitOperator.h"
+#include "Eigenbasis.h"
+#include "ThreadPool.h"
+#include "Birkhoff.h"
+#include "TrajectoryFile.h"
+#include "Profiler.h"
+
+// Empty keeps every writer's usual location; thread-local so concurrent sweep points do not collide
+static thread_local string data_directory;
+
+void set_data_directory(const string& dir) {
+    data_directory = dir;
+}
+
+string data_path(const string& name, const string& fallback) {
+    return data_directory.empty() ? fallback + name : data_directory + "/" + name;
+}
 
 ostream& operator<<(ostream& os, const Vec2& v) {
     os << v.x << "|" << v.y;
@@ -21,16 +52,6 @@ float maximum(vector<float> v) {
     return  ans;
 }
 
-Vec2 move(int i, int t, vector<Vec2> points, int total_frames) {
-    Vec2 p1 = points[i];
-    Vec2 p0 = points[i - 1];
-
-    double x = p0.x + (p1.x - p0.x) * t / total_frames;
-    double y = p0.y + (p1.y - p0.y) * t / total_frames;
-
-    return {x, y};
-}
-
 vector<Circle> parseCircles(const string& s) {
     vector<Circle> circles;
     string trimmed = s;
@@ -66,7 +87,68 @@ vector<Circle> parseCircles(const string& s) {
 }
 
 
-Vec2 next_reflection(SinaiBilliard b,Vec2 d, Vec2 p_i) { //p_i == point of intersection
+// "[L(x0,y0,x1,y1),A(cx,cy,rx,ry,start,sweep)]", edges counter-clockwise, arc angles in degrees
+vector<Edge> parseEdges(const string& s) {
+    vector<Edge> edges;
+
+    size_t pos = 0;
+    while ((pos = s.find_first_of("LlAa", pos)) != string::npos) {
+        char kind = static_cast<char>(toupper(s[pos]));
+        size_t open = s.find('(', pos);
+        size_t close = s.find(')', open);
+        if (open == string::npos || close == string::npos) break;
+
+        stringstream token_ss(s.substr(open + 1, close - open - 1));
+        string num;
+        vector<double> nums;
+        while (getline(token_ss, num, ',')) {
+            nums.push_back(stod(num));
+        }
+
+        if (kind == 'L' && nums.size() == 4) {
+            edges.push_back(Edge::segment({nums[0], nums[1]}, {nums[2], nums[3]}));
+        }
+        if (kind == 'A' && nums.size() == 6) {
+            edges.push_back(Edge::ellipticArc({nums[0], nums[1]}, nums[2], nums[3],
+                                              nums[4] * M_PI / 180.0, nums[5] * M_PI / 180.0));
+        }
+        pos = close + 1;
+    }
+
+    return edges;
+}
+
+// "[E(surface),S(from,to)]": whole surfaces by id, or arc-length intervals in Birkhoff s
+vector<Hole> parseHoles(const string& s) {
+    vector<Hole> holes;
+
+    size_t pos = 0;
+    while ((pos = s.find_first_of("EeSs", pos)) != string::npos) {
+        char kind = static_cast<char>(toupper(s[pos]));
+        size_t open = s.find('(', pos);
+        size_t close = s.find(')', open);
+        if (open == string::npos || close == string::npos) break;
+
+        stringstream token_ss(s.substr(open + 1, close - open - 1));
+        string num;
+        vector<double> nums;
+        while (getline(token_ss, num, ',')) {
+            nums.push_back(stod(num));
+        }
+
+        if (kind == 'E' && nums.size() == 1) {
+            holes.push_back(Hole::whole(static_cast<int>(nums[0])));
+        }
+        if (kind == 'S' && nums.size() == 2) {
+            holes.push_back(Hole::interval(nums[0], nums[1]));
+        }
+        pos = close + 1;
+    }
+
+    return holes;
+}
+
+Vec2 next_reflection(const SinaiBilliard& b, Vec2 d, Vec2 p_i) { //p_i == point of intersection
     Vec2 n = b.getNormal(p_i);
     Vec2 n_normalized = n.normalize();
 
@@ -74,6 +156,12 @@ Vec2 next_reflection(SinaiBilliard b,Vec2 d, Vec2 p_i) { //p_i == point of inter
     return d - n_normalized * (2 * dot);
 }
 
+Vec2 next_reflection(Vec2 d, const Hit& hit) {
+    double dot = d.dot(hit.normal);
+    return d - hit.normal * (2 * dot);
+}
+
+#ifndef BILLIARDS_HEADLESS
 Color probability_to_rgb(float p) {
     Color color;
 
@@ -93,57 +181,619 @@ Color probability_to_rgb(float p) {
     color.a = 255;
     return color;
 }
+#endif
 
-vector<vector<Vec2>> write_classical(SinaiBilliard billiard, Vec2 p0, double angle, int count) {
-    ofstream bin_file("../../data/classical_data.bin", ios::binary);
+vector<vector<Vec2>> write_classical(SinaiBilliard billiard, Vec2 p0, double angle, int count, int threads,
+                                     ClassicalOutput output, int points) {
+    return write_classical(billiard, InitialConditions::fan(p0, angle), count, threads, output, points);
+}
+
+vector<vector<Vec2>> write_classical(SinaiBilliard billiard, const InitialConditions& initial, int count,
+                                     int threads, ClassicalOutput output, int points) {
+    PROFILE_SCOPE("write_classical");
+    bool indexed = output == ClassicalOutput::INDEXED;
+    unique_ptr<TrajectoryWriter> writer;
+    if (indexed) writer.reset(new TrajectoryWriter(data_path("classical_data.traj", "../../data/"), billiard, count, points + 1));
+
+    vector<Sample> samples = initial.generate(billiard, 0, count, threads);
+    vector<vector<Vec2>> trajectories(count, vector<Vec2>(points));
+
+    // Trajectories are independent, so each range of particles is traced by its own ensemble.
+    // Ranges start on multiples of Ensemble::BLOCK, which puts every particle through the same
+    // kernel block it would see in a single serial ensemble: the output does not depend on threads.
+    auto trace = [&](int begin, int end, int) {
+        Ensemble ensemble(billiard);
+        for (int j = begin; j < end; j++) {
+            ensemble.add(samples[j].p, samples[j].d, samples[j].surface);
+        }
+        for (int t = 0; t < points; t++) {
+            ensemble.step();
+            for (int j = begin; j < end; j++) {
+                trajectories[j][t] = ensemble.getPosition(j - begin);
+            }
+        }
+        if (!indexed) return;
+
+        // The whole range goes out as one block of contiguous per-particle chunks
+        vector<double> chunk;
+        chunk.reserve(2 * static_cast<size_t>(end - begin) * (points + 1));
+        for (int j = begin; j < end; j++) {
+            chunk.push_back(samples[j].p.x);
+            chunk.push_back(samples[j].p.y);
+            for (const Vec2& q : trajectories[j]) {
+                chunk.push_back(q.x);
+                chunk.push_back(q.y);
+            }
+        }
+        writer->write(begin, end - begin, chunk.data());
+    };
 
-    vector<Vec2> ds;
-    vector<Vec2> ps;
-    vector<vector<Vec2>> trajectories(count, vector<Vec2>(MAX_POINTS));
+    {
+        PROFILE_SCOPE("write_classical/trace");
+        if (threads == 1) {
+            trace(0, count, 0);
+        } else {
+            ThreadPool pool(threads);
+            int blocks = (count + Ensemble::BLOCK - 1) / Ensemble::BLOCK;
+            int grain = Ensemble::BLOCK * max(1, blocks / (8 * pool.size()));
+            pool.parallel_for(count, grain, trace);
+        }
+    }
+    PROFILE_COUNT("write_classical/trace", "bounces", static_cast<double>(count) * points);
 
-    for (int i = 0; i < count; i++) {
-        ps.emplace_back(p0);
-        ds.emplace_back(cos(angle + (M_PI * i) / 720), sin(angle + (M_PI * i) / 720));
-        trajectories[i][0] = ps[i];
+    if (indexed) {
+        writer->finish();
+        PROFILE_COUNT("write_classical", "bytes_written", writer->getSize());
+        return trajectories;
     }
+    ofstream bin_file(data_path("classical_data.bin", "../../data/"), ios::binary);
 
     // Write metadata: count and max points
-    int max_points = MAX_POINTS;
+    int max_points = points;
     bin_file.write(reinterpret_cast<const char*>(&count), sizeof(int));
     bin_file.write(reinterpret_cast<const char*>(&max_points), sizeof(int));
 
+    // One interleaved x/y row per timestep, written in a single call
+    vector<double> coords(2 * count);
     for (int j = 0; j < count; j++) {
-        bin_file.write(reinterpret_cast<const char*>(&ps[j].x), sizeof(double));
-        bin_file.write(reinterpret_cast<const char*>(&ps[j].y), sizeof(double));
+        coords[2 * j] = samples[j].p.x;
+        coords[2 * j + 1] = samples[j].p.y;
     }
+    bin_file.write(reinterpret_cast<const char*>(coords.data()), coords.size() * sizeof(double));
 
-    // Simulate and write positions
     for (int t = 0; t < max_points; t++) {
         for (int j = 0; j < count; j++) {
-            Vec2 p = ps[j];
-            Vec2 d = ds[j];
-            p = billiard.getIntersectionPoint(p, d);
-            d = next_reflection(billiard, d, p);
-            ds[j] = d;
-            ps[j] = p;
+            coords[2 * j] = trajectories[j][t].x;
+            coords[2 * j + 1] = trajectories[j][t].y;
+        }
+        bin_file.write(reinterpret_cast<const char*>(coords.data()), coords.size() * sizeof(double));
+    }
+    PROFILE_COUNT("write_classical", "bytes_written", bin_file.tellp());
+    return trajectories;
+}
 
-            double coords[2] = { p.x, p.y };
-            trajectories[j][t] = p;
-            bin_file.write(reinterpret_cast<const char*>(coords), sizeof(coords));
+vector<vector<Vec2>> write_magnetic(const SinaiBilliard& billiard, double field, Vec2 p0, double angle, int count,
+                                    int points, int threads) {
+    return write_magnetic(billiard, field, InitialConditions::fan(p0, angle), count, points, threads);
+}
+
+vector<vector<Vec2>> write_magnetic(const SinaiBilliard& billiard, double field, const InitialConditions& initial,
+                                    int count, int points, int threads) {
+    PROFILE_SCOPE("write_magnetic");
+    MagneticBilliard magnetic(billiard, field);
+    vector<Sample> samples = initial.generate(billiard, 0, count, threads);
+
+    // Particle-major while tracing: x, y, vx, vy for the initial state and every bounce
+    vector<double> states(4 * static_cast<size_t>(count) * (points + 1));
+    vector<vector<Vec2>> trajectories(count, vector<Vec2>(points));
+    ThreadPool pool(threads);
+    pool.parallel_for(count, 16, [&](int begin, int end, int) {
+        for (int j = begin; j < end; j++) {
+            Vec2 p = samples[j].p, d = samples[j].d.normalize();
+            int surface = samples[j].surface;
+            double* row = states.data() + 4 * static_cast<size_t>(j) * (points + 1);
+            row[0] = p.x; row[1] = p.y; row[2] = d.x; row[3] = d.y;
+
+            for (int t = 0; t < points; t++) {
+                Hit hit = magnetic.intersect(p, d, surface);
+                if (hit.surface >= 0) {
+                    // Velocity on arrival, then the same specular reflection as the field-free run
+                    Vec2 arrival;
+                    magnetic.advance(p, d, hit.t, arrival);
+                    p = hit.point;
+                    d = next_reflection(arrival, hit).normalize();
+                    surface = hit.surface;
+                }
+                trajectories[j][t] = p;
+                double* state = row + 4 * (t + 1);
+                state[0] = p.x; state[1] = p.y; state[2] = d.x; state[3] = d.y;
+            }
         }
+    });
+    PROFILE_COUNT("write_magnetic", "bounces", static_cast<double>(count) * points);
+
+    ofstream bin_file(data_path("magnetic_data.bin", "../../data/"), ios::binary);
+
+    // Metadata: count, points, field; then one x/y/vx/vy row of every particle per timestep
+    bin_file.write(reinterpret_cast<const char*>(&count), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&points), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&field), sizeof(double));
+    vector<double> row(4 * static_cast<size_t>(count));
+    for (int t = 0; t <= points; t++) {
+        for (int j = 0; j < count; j++) {
+            copy_n(states.data() + 4 * (static_cast<size_t>(j) * (points + 1) + t), 4, row.data() + 4 * j);
+        }
+        bin_file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(double));
     }
+    PROFILE_COUNT("write_magnetic", "bytes_written", bin_file.tellp());
     return trajectories;
 }
 
+void write_resampled(const string& traj_path, double dt, int samples, int threads) {
+    PROFILE_SCOPE("write_resampled");
+    TrajectoryFile trajectories(traj_path);
+    ofstream bin_file(data_path("resampled_data.bin", "../../data/"), ios::binary);
+    const int BATCH = 256; // particles resampled between two writes
+
+    // Metadata: particles, samples, dt
+    int particles = trajectories.getParticles();
+    bin_file.write(reinterpret_cast<const char*>(&particles), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&samples), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&dt), sizeof(double));
+
+    ThreadPool pool(threads);
+    vector<double> rows(4 * static_cast<size_t>(BATCH) * samples);
+    for (int first = 0; first < particles; first += BATCH) {
+        int n = min(BATCH, particles - first);
+        pool.parallel_for(n, 1, [&](int begin, int end, int) {
+            vector<Vec2> positions(samples), velocities(samples);
+            for (int j = begin; j < end; j++) {
+                TimeIndex index = trajectories.getTimeIndex(first + j);
+                index.sample(0, dt, samples, positions.data(), velocities.data());
+                double* row = rows.data() + 4 * static_cast<size_t>(j) * samples;
+                for (int s = 0; s < samples; s++) {
+                    row[4 * s] = positions[s].x;
+                    row[4 * s + 1] = positions[s].y;
+                    row[4 * s + 2] = velocities[s].x;
+                    row[4 * s + 3] = velocities[s].y;
+                }
+            }
+        });
+        bin_file.write(reinterpret_cast<const char*>(rows.data()), 4 * static_cast<size_t>(n) * samples * sizeof(double));
+    }
+    PROFILE_COUNT("write_resampled", "samples", static_cast<double>(particles) * samples);
+    PROFILE_COUNT("write_resampled", "bytes_written", bin_file.tellp());
+}
+
+BirkhoffHistogram write_birkhoff(const SinaiBilliard& billiard, Vec2 p0, double angle, int count,
+                                 long long bounces, BirkhoffOutput output,
+                                 int bins_s, int bins_p, int threads) {
+    return write_birkhoff(billiard, InitialConditions::fan(p0, angle), count, bounces, output, bins_s, bins_p, threads);
+}
+
+BirkhoffHistogram write_birkhoff(const SinaiBilliard& billiard, const InitialConditions& initial, int count,
+                                 long long bounces, BirkhoffOutput output,
+                                 int bins_s, int bins_p, int threads) {
+    PROFILE_SCOPE("write_birkhoff");
+    ofstream bin_file(data_path("birkhoff_data.bin", "../../data/"), ios::binary);
+    const int CHUNK = 256; // bounces simulated between two writes
+    bool stream = output == BirkhoffOutput::STREAM;
+    double perimeter = billiard.getPerimeter();
+
+    // Particles are split into fixed ranges up front so the result does not depend on threads
+    ThreadPool pool(threads);
+    int blocks = (count + Ensemble::BLOCK - 1) / Ensemble::BLOCK;
+    int range = Ensemble::BLOCK * max(1, blocks / (8 * pool.size()));
+    int ranges = (count + range - 1) / range;
+
+    vector<Sample> samples = initial.generate(billiard, 0, count, threads);
+    vector<Ensemble> ensembles;
+    for (int r = 0; r < ranges; r++) {
+        ensembles.emplace_back(billiard);
+        for (int j = r * range; j < min(count, (r + 1) * range); j++) {
+            ensembles.back().add(samples[j].p, samples[j].d, samples[j].surface);
+        }
+    }
+
+    // One private histogram per worker, merged at the end
+    vector<BirkhoffHistogram> histograms(pool.size(), BirkhoffHistogram(bins_s, bins_p, perimeter));
+    vector<float> chunk(stream ? 2 * static_cast<size_t>(count) * CHUNK : 0);
+
+    if (stream) {
+        bin_file.write(reinterpret_cast<const char*>(&count), sizeof(int));
+        bin_file.write(reinterpret_cast<const char*>(&bounces), sizeof(long long));
+        bin_file.write(reinterpret_cast<const char*>(&perimeter), sizeof(double));
+    }
+
+    for (long long done = 0; done < bounces; done += CHUNK) {
+        int steps = static_cast<int>(min<long long>(CHUNK, bounces - done));
+
+        pool.parallel_for(ranges, 1, [&](int begin, int end, int w) {
+            for (int r = begin; r < end; r++) {
+                Ensemble& ensemble = ensembles[r];
+                for (int k = 0; k < steps; k++) {
+                    ensemble.step();
+                    for (int j = 0; j < ensemble.size(); j++) {
+                        int surface = ensemble.getSurface(j);
+                        Vec2 sp(NAN, NAN);
+                        if (surface >= 0) {
+                            sp = billiard.getBirkhoff(surface, ensemble.getPosition(j), ensemble.getDirection(j));
+                            histograms[w].add(sp.x, sp.y);
+                        }
+                        if (stream) {
+                            size_t at = 2 * (static_cast<size_t>(k) * count + r * range + j);
+                            chunk[at] = static_cast<float>(sp.x);
+                            chunk[at + 1] = static_cast<float>(sp.y);
+                        }
+                    }
+                }
+            }
+        });
+
+        if (stream) {
+            bin_file.write(reinterpret_cast<const char*>(chunk.data()), 2 * static_cast<size_t>(count) * steps * sizeof(float));
+        }
+    }
+
+    PROFILE_COUNT("write_birkhoff", "bounces", static_cast<double>(count) * bounces);
+    for (int w = 1; w < pool.size(); w++) {
+        histograms[0].merge(histograms[w]);
+    }
+
+    if (!stream) {
+        // Metadata: bins, perimeter and number of samples, then the counts s-major
+        uint64_t total = histograms[0].getTotal();
+        bin_file.write(reinterpret_cast<const char*>(&bins_s), sizeof(int));
+        bin_file.write(reinterpret_cast<const char*>(&bins_p), sizeof(int));
+        bin_file.write(reinterpret_cast<const char*>(&perimeter), sizeof(double));
+        bin_file.write(reinterpret_cast<const char*>(&total), sizeof(uint64_t));
+        bin_file.write(reinterpret_cast<const char*>(histograms[0].getCounts().data()),
+                       histograms[0].getCounts().size() * sizeof(uint64_t));
+    }
+    PROFILE_COUNT("write_birkhoff", "bytes_written", bin_file.tellp());
+    return histograms[0];
+}
+
+OccupationHistogram write_occupation(const SinaiBilliard& billiard, Vec2 p0, double angle, int count,
+                                     long long bounces, int nx, int ny, int frames, int threads) {
+    return write_occupation(billiard, InitialConditions::fan(p0, angle), count, bounces, nx, ny, frames, threads);
+}
+
+OccupationHistogram write_occupation(const SinaiBilliard& billiard, const InitialConditions& initial, int count,
+                                     long long bounces, int nx, int ny, int frames, int threads) {
+    PROFILE_SCOPE("write_occupation");
+    ofstream bin_file(data_path("occupation_data.bin", "../../data/"), ios::binary);
+    frames = static_cast<int>(max(1LL, min<long long>(frames, max(1LL, bounces))));
+    Vec2 lo = billiard.getOuter().getLower(), hi = billiard.getOuter().getUpper();
+
+    // Fixed ranges as in write_birkhoff
+    ThreadPool pool(threads);
+    int blocks = (count + Ensemble::BLOCK - 1) / Ensemble::BLOCK;
+    int range = Ensemble::BLOCK * max(1, blocks / (8 * pool.size()));
+    int ranges = (count + range - 1) / range;
+
+    vector<Sample> samples = initial.generate(billiard, 0, count, threads);
+    vector<Ensemble> ensembles;
+    for (int r = 0; r < ranges; r++) {
+        ensembles.emplace_back(billiard);
+        for (int j = r * range; j < min(count, (r + 1) * range); j++) {
+            ensembles.back().add(samples[j].p, samples[j].d, samples[j].surface);
+        }
+    }
+
+    // One private histogram per worker; lengths are integer counts, so the merge is exact
+    vector<OccupationHistogram> histograms(pool.size(), OccupationHistogram(nx, ny, lo, hi));
+
+    // Metadata: nx, ny, frames, bounding box; then one float frame of nx * ny cells each
+    bin_file.write(reinterpret_cast<const char*>(&nx), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&ny), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&frames), sizeof(int));
+    double box[4] = {lo.x, lo.y, hi.x, hi.y};
+    bin_file.write(reinterpret_cast<const char*>(box), sizeof(box));
+
+    // A frame may cover any number of bounces; they are run CHUNK at a time
+    const int CHUNK = 4096;
+    OccupationHistogram merged(nx, ny, lo, hi);
+    long long done = 0;
+    for (int f = 1; f <= frames; f++) {
+        // floor(bounces * f / frames) without overflowing the product
+        long long target = bounces / frames * f + bounces % frames * f / frames;
+        while (done < target) {
+            int steps = static_cast<int>(min<long long>(CHUNK, target - done));
+            done += steps;
+
+            pool.parallel_for(ranges, 1, [&](int begin, int end, int w) {
+                vector<double> x0, y0;
+                for (int r = begin; r < end; r++) {
+                    Ensemble& ensemble = ensembles[r];
+                    for (int k = 0; k < steps; k++) {
+                        x0 = ensemble.getX();
+                        y0 = ensemble.getY();
+                        ensemble.step();
+                        for (int j = 0; j < ensemble.size(); j++) {
+                            histograms[w].addSegment({x0[j], y0[j]}, ensemble.getPosition(j));
+                        }
+                    }
+                }
+            });
+        }
+
+        merged = OccupationHistogram(nx, ny, lo, hi);
+        for (const auto& h : histograms) merged.merge(h);
+        vector<float> density = merged.getDensity();
+        bin_file.write(reinterpret_cast<const char*>(density.data()), density.size() * sizeof(float));
+    }
+    PROFILE_COUNT("write_occupation", "segments", static_cast<double>(count) * bounces);
+    PROFILE_COUNT("write_occupation", "bytes_written", bin_file.tellp());
+    return merged;
+}
+
+vector<double> write_lyapunov(const SinaiBilliard& billiard, Vec2 p0, double angle, int count,
+                              long long bounces, int window, int threads) {
+    return write_lyapunov(billiard, InitialConditions::fan(p0, angle), count, bounces, window, threads);
+}
+
+vector<double> write_lyapunov(const SinaiBilliard& billiard, const InitialConditions& initial, int count,
+                              long long bounces, int window, int threads) {
+    PROFILE_SCOPE("write_lyapunov");
+    ofstream bin_file(data_path("lyapunov_data.bin", "../../data/"), ios::binary);
+    window = max(1, window);
+    int windows = static_cast<int>((bounces + window - 1) / window);
+
+    // Fixed ranges as in write_birkhoff, so the exponents do not depend on threads
+    ThreadPool pool(threads);
+    int blocks = (count + Ensemble::BLOCK - 1) / Ensemble::BLOCK;
+    int range = Ensemble::BLOCK * max(1, blocks / (8 * pool.size()));
+    int ranges = (count + range - 1) / range;
+
+    vector<Sample> samples = initial.generate(billiard, 0, count, threads);
+    vector<Lyapunov> engines;
+    for (int r = 0; r < ranges; r++) {
+        engines.emplace_back(billiard);
+        for (int j = r * range; j < min(count, (r + 1) * range); j++) {
+            engines.back().add(samples[j].p, samples[j].d, samples[j].surface);
+        }
+    }
+
+    // Metadata: count, number of windows, bounces per window
+    bin_file.write(reinterpret_cast<const char*>(&count), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&windows), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&window), sizeof(int));
+
+    vector<double> row(count);
+    for (long long done = 0; done < bounces; done += window) {
+        int steps = static_cast<int>(min<long long>(window, bounces - done));
+
+        pool.parallel_for(ranges, 1, [&](int begin, int end, int) {
+            for (int r = begin; r < end; r++) {
+                for (int k = 0; k < steps; k++) {
+                    engines[r].step();
+                }
+                vector<double> exponents = engines[r].finiteTime();
+                copy(exponents.begin(), exponents.end(), row.begin() + r * range);
+            }
+        });
+        bin_file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(double));
+    }
+
+    vector<double> per_length(count), per_bounce(count);
+    for (int r = 0; r < ranges; r++) {
+        for (int j = 0; j < engines[r].size(); j++) {
+            per_length[r * range + j] = engines[r].getExponent(j);
+            per_bounce[r * range + j] = engines[r].getExponentPerBounce(j);
+        }
+    }
+    bin_file.write(reinterpret_cast<const char*>(per_length.data()), per_length.size() * sizeof(double));
+    bin_file.write(reinterpret_cast<const char*>(per_bounce.data()), per_bounce.size() * sizeof(double));
+    PROFILE_COUNT("write_lyapunov", "bounces", static_cast<double>(count) * bounces);
+    PROFILE_COUNT("write_lyapunov", "bytes_written", bin_file.tellp());
+    return per_length;
+}
+
+vector<double> write_escape(const SinaiBilliard& billiard, const vector<Hole>& holes, Vec2 p0, double angle,
+                            int count, long long bounces, int bins, int threads) {
+    return write_escape(billiard, holes, InitialConditions::fan(p0, angle), count, bounces, bins, threads);
+}
+
+vector<double> write_escape(const SinaiBilliard& billiard, const vector<Hole>& holes,
+                            const InitialConditions& initial, int count, long long bounces, int bins, int threads) {
+    PROFILE_SCOPE("write_escape");
+    ofstream bin_file(data_path("escape_data.bin", "../../data/"), ios::binary);
+    bins = max(1, bins);
+
+    // Fixed ranges as in write_lyapunov; each engine compacts its own particles
+    ThreadPool pool(threads);
+    int blocks = (count + Ensemble::BLOCK - 1) / Ensemble::BLOCK;
+    int range = Ensemble::BLOCK * max(1, blocks / (8 * pool.size()));
+    int ranges = (count + range - 1) / range;
+
+    vector<Sample> samples = initial.generate(billiard, 0, count, threads);
+    vector<Escape> engines;
+    for (int r = 0; r < ranges; r++) {
+        engines.emplace_back(billiard);
+        for (const Hole& hole : holes) engines.back().addHole(hole);
+        for (int j = r * range; j < min(count, (r + 1) * range); j++) {
+            engines.back().add(samples[j].p, samples[j].d, samples[j].surface);
+        }
+    }
+
+    pool.parallel_for(ranges, 1, [&](int begin, int end, int) {
+        for (int r = begin; r < end; r++) {
+            while (engines[r].getActive() > 0 && engines[r].getBounces() < bounces) {
+                engines[r].step();
+            }
+        }
+    });
+
+    vector<double> times(count);
+    vector<long long> escape_bounces(count);
+    int escaped = 0;
+    double horizon = numeric_limits<double>::infinity();
+    double latest = 0;
+    for (int r = 0; r < ranges; r++) {
+        horizon = min(horizon, engines[r].getHorizon());
+        for (int j = 0; j < engines[r].size(); j++) {
+            double t = engines[r].getEscapeTime(j);
+            times[r * range + j] = t;
+            escape_bounces[r * range + j] = engines[r].getEscapeBounce(j);
+            if (isfinite(t)) {
+                escaped++;
+                latest = max(latest, t);
+            }
+        }
+        PROFILE_COUNT("write_escape", "compactions", engines[r].getCompactions());
+    }
+
+    // P(t) is only known up to where the slowest survivor got
+    double t_max = isfinite(horizon) ? horizon : latest;
+    if (!(t_max > 0)) t_max = 1;
+    vector<double> survival = Escape::survival(times, count, t_max, bins);
+    vector<uint64_t> histogram = Escape::histogram(times, t_max, bins);
+
+    // Metadata: count, escaped, bins, t_max; then P(t), the histogram, per-particle times and bounces
+    bin_file.write(reinterpret_cast<const char*>(&count), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&escaped), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&bins), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&t_max), sizeof(double));
+    bin_file.write(reinterpret_cast<const char*>(survival.data()), survival.size() * sizeof(double));
+    bin_file.write(reinterpret_cast<const char*>(histogram.data()), histogram.size() * sizeof(uint64_t));
+    bin_file.write(reinterpret_cast<const char*>(times.data()), times.size() * sizeof(double));
+    bin_file.write(reinterpret_cast<const char*>(escape_bounces.data()), escape_bounces.size() * sizeof(long long));
+    PROFILE_COUNT("write_escape", "escaped", escaped);
+    PROFILE_COUNT("write_escape", "bytes_written", bin_file.tellp());
+    return survival;
+}
+
+HardDiskGas write_gas(const SinaiBilliard& billiard, int count, double radius, double speed,
+                      int frames, double dt, unsigned seed) {
+    PROFILE_SCOPE("write_gas");
+    ofstream bin_file(data_path("gas_data.bin", "../../data/"), ios::binary);
+    HardDiskGas gas(billiard, radius);
+
+    // Disks on a square lattice slightly wider than a diameter, random directions
+    mt19937_64 rng(seed);
+    uniform_real_distribution<double> direction(0, 2 * M_PI);
+    Vec2 lo = gas.getWalls().getOuter().getLower();
+    Vec2 hi = gas.getWalls().getOuter().getUpper();
+    double spacing = 2.2 * radius;
+    for (double y = lo.y + spacing / 2; y < hi.y && gas.size() < count; y += spacing) {
+        for (double x = lo.x + spacing / 2; x < hi.x && gas.size() < count; x += spacing) {
+            double a = direction(rng);
+            gas.add({x, y}, {speed * cos(a), speed * sin(a)});
+        }
+    }
+
+    // Metadata: disks actually placed, frames, radius; then one x/y row per frame
+    int placed = gas.size();
+    bin_file.write(reinterpret_cast<const char*>(&placed), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&frames), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&radius), sizeof(double));
+
+    vector<double> coords(2 * static_cast<size_t>(placed));
+    for (int f = 0; f <= frames; f++) {
+        gas.advance(f * dt);
+        for (int i = 0; i < placed; i++) {
+            Vec2 p = gas.getPosition(i);
+            coords[2 * i] = p.x;
+            coords[2 * i + 1] = p.y;
+        }
+        bin_file.write(reinterpret_cast<const char*>(coords.data()), coords.size() * sizeof(double));
+    }
+    PROFILE_COUNT("write_gas", "collisions", gas.getDiskCollisions() + gas.getWallCollisions());
+    PROFILE_COUNT("write_gas", "bytes_written", bin_file.tellp());
+    return gas;
+}
+
+// Mean energy <H> of a packet on the stencil's planes, H = -1/2 Lap, and its spread
+// sqrt(<H^2> - <H>^2); H is symmetric, so <H^2> is |H psi|^2
+static double packet_energy(const Stencil& stencil, const SplitField& psi, double& spread) {
+    SplitField lap = stencil.field();
+    stencil.laplacian(psi, lap);
+    double energy = 0, square = 0, norm = 0;
+    for (size_t c = 0; c < psi.re.size(); c++) {
+        energy -= 0.5 * (psi.re[c] * lap.re[c] + psi.im[c] * lap.im[c]);
+        square += 0.25 * (lap.re[c] * lap.re[c] + lap.im[c] * lap.im[c]);
+        norm += psi.re[c] * psi.re[c] + psi.im[c] * psi.im[c];
+    }
+    if (norm == 0) {
+        spread = 0;
+        return 0;
+    }
+    energy /= norm;
+    spread = sqrt(max(0.0, square / norm - energy * energy));
+    return energy;
+}
+
+// Weyl's law with the Dirichlet boundary term for the states of H below energy E: with
+// -Lap = k^2 = 2E, N = (area k^2 - perimeter k) / 4 pi. The staircase perimeter is longer
+// than the wall and the grid packs more states under E than the continuum, so this
+// undercounts.
+static double weyl_count(const Stencil& stencil, double energy) {
+    const vector<double>& mask = stencil.getMask();
+    int stride = stencil.getStride();
+    double cells = 0, faces = 0;
+    for (int i = 0; i < stencil.getNx(); i++) {
+        for (int j = 0; j < stencil.getNy(); j++) {
+            int c = stencil.index(i, j);
+            if (mask[c] == 0) continue;
+            cells += 1;
+            faces += 4 - (mask[c - stride] + mask[c + stride] + mask[c - 1] + mask[c + 1]);
+        }
+    }
+    double dh = stencil.getDh(), k = sqrt(2 * max(0.0, energy));
+    return max(0.0, (cells * dh * dh * k * k - faces * dh * k) / (4 * M_PI));
+}
+
+// The eigenbasis for this grid, from the data directory's cache when it was computed before
+static Eigenbasis eigenbasis(const vector<int>& boundary, int nx, int ny, double dh, int count, double shift) {
+    char name[64];
+    snprintf(name, sizeof(name), "eigenbasis_%016llx.bin",
+             static_cast<unsigned long long>(Eigenbasis::hash(nx, ny, dh, boundary, count, shift)));
+    return Eigenbasis::cached(data_path(name), nx, ny, dh, boundary, count, shift);
+}
+
+Eigenbasis write_eigenstates(const SinaiBilliard& billiard, double dh, int count, double shift) {
+    PROFILE_SCOPE("write_eigenstates");
+    int nx = static_cast<int>(WIDTH / dh);
+    int ny = static_cast<int>(HEIGHT / dh);
+    vector<int> boundary = billiard.getBoundary(WIDTH, HEIGHT, dh);
+    Eigenbasis basis = eigenbasis(boundary, nx, ny, dh, count, shift);
+
+    // Metadata: nx, ny, states, then the energies
+    ofstream bin_file(data_path("eigen_data.bin"), ios::binary);
+    int states = basis.getCount();
+    bin_file.write(reinterpret_cast<const char*>(&nx), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&ny), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(&states), sizeof(int));
+    bin_file.write(reinterpret_cast<const char*>(basis.getEnergies().data()), states * sizeof(double));
+
+    // |state|^2 per state, scaled so its largest cell is 1 like the quantum frames
+    vector<float> density(static_cast<size_t>(nx) * ny);
+    for (int n = 0; n < states; n++) {
+        vector<double> state = basis.getState(n);
+        double max_v = 0;
+        for (double v : state) max_v = max(max_v, v * v);
+        for (size_t c = 0; c < state.size(); c++) {
+            density[c] = static_cast<float>(max_v > 0 ? state[c] * state[c] / max_v : 0);
+        }
+        bin_file.write(reinterpret_cast<const char*>(density.data()), density.size() * sizeof(float));
+    }
+    PROFILE_COUNT("write_eigenstates", "states", states);
+    PROFILE_COUNT("write_eigenstates", "bytes_written", bin_file.tellp());
+    return basis;
+}
+
 vector<vector<float>> write_quantum(double dh, double dt, double sigma, double x0, double y0, double k, double theta,
-                   const SinaiBilliard& billiard) {
-    ofstream bin_file("./data/quantum_data.bin", ios::binary);
+                   const SinaiBilliard& billiard, int threads, QuantumEngine engine, int states, double tolerance) {
+    PROFILE_SCOPE("write_quantum");
+    ofstream bin_file(data_path("quantum_data.bin", "./data/"), ios::binary);
 
     int nx = static_cast<int>(WIDTH / dh);
     int ny = static_cast<int>(HEIGHT / dh);
     Schrodinger schrodinger(nx, ny, dh, dt, sigma);
 
     vector<int> boundary = billiard.getBoundary(WIDTH, HEIGHT, dh);
+    Stencil stencil(nx, ny, dh, boundary);
     vector<complex<double>> psi = schrodinger.gaussian_packet(nx, ny, x0, y0, k, theta);
     vector<vector<float>> densities;
 
@@ -170,10 +820,73 @@ vector<vector<float>> write_quantum(double dh, double dt, double sigma, double x
     bin_file.write(reinterpret_cast<const char*>(prob_density.data()), prob_density.size() * sizeof(float));
     densities.emplace_back(prob_density);
 
-    // Subsequent timesteps
+    // Subsequent timesteps. RK4 steps in place on the stencil's split planes; walls do not
+    // evolve, so storing back each frame leaves their initial values in psi. The split
+    // operator takes as few steps per frame as its wall barrier allows, the spectral engine
+    // jumps straight to each frame's time from the packet's expansion, and the Chebyshev
+    // engine covers a frame in one expansion on the same planes as RK4.
+    SplitField state = stencil.field();
+    stencil.load(psi, state);
+    unique_ptr<SplitOperator> splitter;
+    int substeps = 1;
+    if (engine == QuantumEngine::SPLIT_OPERATOR) {
+        double wall = SplitOperator::defaultWall(dh);
+        substeps = SplitOperator::steps(10 * dt, wall);
+        splitter.reset(new SplitOperator(nx, ny, dh, 10 * dt / substeps, boundary, wall));
+    }
+    unique_ptr<Eigenbasis> basis;
+    vector<complex<double>> coefficients;
+    if (engine == QuantumEngine::SPECTRAL) {
+        PROFILE_SCOPE("write_quantum/eigenbasis");
+        if (states < 1) throw runtime_error("write_quantum: the spectral engine needs a positive state count");
+        // The lowest states only reach up the spectrum as far as Weyl's law allows; a
+        // basis that stops short of the packet's mean energy cannot hold it, so that fails
+        // here rather than after the solve
+        double spread, energy = packet_energy(stencil, state, spread);
+        if (states < weyl_count(stencil, energy)) {
+            long needed = static_cast<long>(min(weyl_count(stencil, energy + 3 * spread), 1.0 * nx * ny));
+            throw runtime_error("write_quantum: " + to_string(states) + " eigenstates stop below the packet's mean energy;"
+                                " it needs more than " + to_string(needed) + ", or a smoother packet (wider sigma, smaller k)");
+        }
+        basis.reset(new Eigenbasis(eigenbasis(boundary, nx, ny, dh, states, 0)));
+        coefficients = basis->project(psi);
+        double captured = basis->captured(psi, coefficients);
+        if (captured < MIN_CAPTURED) {
+            throw runtime_error("write_quantum: " + to_string(basis->getCount()) + " eigenstates hold only " +
+                                to_string(100 * captured) + "% of the packet; raise states");
+        }
+    }
+    ThreadPool pool(threads);
     for (int t = 0; t < MAX_POINTS; t++) {
-        for (int j = 0; j < 10; j++) {
-            psi = schrodinger.RK4_Schrodinger(psi, boundary, nx, ny);
+        if (basis) {
+            PROFILE_SCOPE("write_quantum/spectral");
+            basis->evolve(coefficients, 10 * dt * (t + 1), psi, pool);
+        } else if (splitter) {
+            PROFILE_SCOPE("write_quantum/split");
+            for (int j = 0; j < substeps; j++) {
+                splitter->step(psi, pool);
+            }
+            PROFILE_COUNT("write_quantum/split", "steps", substeps);
+        } else if (engine == QuantumEngine::CHEBYSHEV) {
+            {
+                PROFILE_SCOPE("write_quantum/chebyshev");
+                [[maybe_unused]] int order = schrodinger.Chebyshev_inplace(stencil, state, 10 * dt, tolerance, pool);
+                // One Laplacian stencil pass per term
+                PROFILE_COUNT("write_quantum/chebyshev", "order", order);
+                PROFILE_COUNT("write_quantum/chebyshev", "cell_updates", static_cast<double>(order) * nx * ny);
+            }
+            stencil.store(state, psi);
+        } else {
+            {
+                PROFILE_SCOPE("write_quantum/rk4");
+                for (int j = 0; j < 10; j++) {
+                    schrodinger.RK4_inplace(stencil, state, pool);
+                }
+            }
+            stencil.store(state, psi);
+            // Four Laplacian stencil passes per RK4 step
+            PROFILE_COUNT("write_quantum/rk4", "rk4_steps", 10);
+            PROFILE_COUNT("write_quantum/rk4", "cell_updates", 40.0 * nx * ny);
         }
 
         for (size_t i = 0; i < psi.size(); i++) {
@@ -183,5 +896,6 @@ vector<vector<float>> write_quantum(double dh, double dt, double sigma, double x
         densities.emplace_back(prob_density);
         bin_file.write(reinterpret_cast<const char*>(prob_density.data()), prob_density.size() * sizeof(float));
     }
+    PROFILE_COUNT("write_quantum", "bytes_written", bin_file.tellp());
     return densities;
 }
\ No newline at end of file
@@ -2,12 +2,21 @@
 #include <vector>
 #include <string>
 #include <ostream>
+#include "Birkhoff.h"
+#include "Eigenbasis.h"
+#include "HardDiskGas.h"
+#include "Escape.h"
+#include "InitialConditions.h"
+#include "Occupation.h"
+#include "MagneticBilliard.h"
 
 using namespace std;
 
 // Forward declarations for your custom types
 struct Vec2;
 struct Circle;
+struct Hit;
+struct Edge;
 struct Color;
 class SinaiBilliard;
 class Schrodinger;
@@ -22,15 +31,127 @@ ostream& operator<<(ostream& os, const Vec2& v);
 
 // Utility functions
 float maximum(vector<float> v);
-Vec2 move(int i, int t, vector<Vec2> points, int total_frames);
 vector<Circle> parseCircles(const string& s);
-Vec2 next_reflection(SinaiBilliard b, Vec2 d, Vec2 p_i);
+vector<Edge> parseEdges(const string& s);
+vector<Hole> parseHoles(const string& s);
+Vec2 next_reflection(const SinaiBilliard& b, Vec2 d, Vec2 p_i);
+Vec2 next_reflection(Vec2 d, const Hit& hit);
+#ifndef BILLIARDS_HEADLESS
 Color probability_to_rgb(float p);
+#endif
+
+// Directory the write_* functions below put their files in, for the calling thread only.
+// Empty (the default) keeps the usual ../../data/ (./data/ for the quantum run).
+void set_data_directory(const string& dir);
+// Where a write_* function puts `name`: in that directory, or under fallback when it is unset
+string data_path(const string& name, const string& fallback = "../../data/");
 
 // Simulation functions
+// threads: 1 runs serially, 0 uses every core; the output is identical either way.
+// The particle runs take their starting states either as (p0, angle), the classic fan of
+// directions pi / 720 apart, or from any InitialConditions.
+// points: bounces per particle.
+// RAW writes classical_data.bin one timestep row at a time; INDEXED writes the
+// self-describing, particle-major classical_data.traj read back by TrajectoryFile.
+enum class ClassicalOutput { RAW, INDEXED };
+vector<vector<Vec2>> write_classical(
+    SinaiBilliard billiard, Vec2 p0, double angle, int count, int threads = 1,
+    ClassicalOutput output = ClassicalOutput::RAW, int points = MAX_POINTS);
 vector<vector<Vec2>> write_classical(
-    SinaiBilliard billiard, Vec2 p0, double angle, int count);
+    SinaiBilliard billiard, const InitialConditions& initial, int count, int threads = 1,
+    ClassicalOutput output = ClassicalOutput::RAW, int points = MAX_POINTS);
+
+// Resamples every trajectory of an indexed classical_data.traj onto the time grid
+// 0, dt, ..., (samples - 1) * dt at unit speed, for autocorrelation and diffusion work.
+// Writes resampled_data.bin: particles, samples, dt, then per particle `samples` rows of
+// x, y, vx, vy doubles (particles that stop early stay on their last point with vx = vy = 0).
+void write_resampled(const string& traj_path, double dt, int samples, int threads = 1);
+
+// Charged particles in a uniform field: flights are arcs of radius 1 / |field|, solved
+// in closed form, with the usual specular reflection at every bounce. Writes count and
+// points, the field, then points + 1 rows, one per bounce with the initial state first,
+// of x, y, vx, vy for every particle; an arc follows from its start, velocity and the field.
+vector<vector<Vec2>> write_magnetic(
+    const SinaiBilliard& billiard, double field, Vec2 p0, double angle, int count, int points = MAX_POINTS,
+    int threads = 1);
+vector<vector<Vec2>> write_magnetic(
+    const SinaiBilliard& billiard, double field, const InitialConditions& initial, int count,
+    int points = MAX_POINTS, int threads = 1);
+
+// Phase-space run that never stores trajectories: every bounce is reduced on the fly to
+// Birkhoff coordinates (s, sin of the reflection angle) and binned into a bins_s x bins_p
+// histogram. HISTOGRAM writes the histogram at the end; STREAM instead appends the raw
+// (s, p) float pairs to disk every few hundred bounces.
+enum class BirkhoffOutput { HISTOGRAM, STREAM };
+BirkhoffHistogram write_birkhoff(
+    const SinaiBilliard& billiard, Vec2 p0, double angle, int count, long long bounces,
+    BirkhoffOutput output = BirkhoffOutput::HISTOGRAM, int bins_s = 512, int bins_p = 512, int threads = 1);
+BirkhoffHistogram write_birkhoff(
+    const SinaiBilliard& billiard, const InitialConditions& initial, int count, long long bounces,
+    BirkhoffOutput output = BirkhoffOutput::HISTOGRAM, int bins_s = 512, int bins_p = 512, int threads = 1);
 
+// Classical counterpart of the quantum density frames: every free flight of every particle
+// is rasterised into an nx x ny occupation histogram over the table's bounding box as it
+// happens, so no trajectory is ever stored. Writes `frames` snapshots of the cumulative
+// density, bounces / frames bounces apart, each scaled so its fullest cell is 1.
+OccupationHistogram write_occupation(
+    const SinaiBilliard& billiard, Vec2 p0, double angle, int count, long long bounces,
+    int nx = 256, int ny = 256, int frames = 1, int threads = 1);
+OccupationHistogram write_occupation(
+    const SinaiBilliard& billiard, const InitialConditions& initial, int count, long long bounces,
+    int nx = 256, int ny = 256, int frames = 1, int threads = 1);
+
+// Largest Lyapunov exponent per particle from the tangent map, no trajectory pairs needed.
+// Writes one row of finite-time exponents (per unit length) every `window` bounces, then
+// the asymptotic exponents per unit length and per bounce; returns the former.
+vector<double> write_lyapunov(
+    const SinaiBilliard& billiard, Vec2 p0, double angle, int count, long long bounces,
+    int window = 1000, int threads = 1);
+vector<double> write_lyapunov(
+    const SinaiBilliard& billiard, const InitialConditions& initial, int count, long long bounces,
+    int window = 1000, int threads = 1);
+
+// Open billiard: particles leave through the holes and are dropped from the ensemble.
+// Runs until everyone has escaped or `bounces` bounces, then writes the survival
+// probability P(t) at bins + 1 path lengths up to the largest t every survivor reached,
+// the escape-time histogram over the same range, and every particle's escape time and
+// bounce (infinity and -1 for survivors). Returns P(t).
+vector<double> write_escape(
+    const SinaiBilliard& billiard, const vector<Hole>& holes, Vec2 p0, double angle, int count,
+    long long bounces, int bins = 200, int threads = 1);
+vector<double> write_escape(
+    const SinaiBilliard& billiard, const vector<Hole>& holes, const InitialConditions& initial, int count,
+    long long bounces, int bins = 200, int threads = 1);
+
+// Interacting mode: up to `count` hard disks of the given radius, placed on a lattice with
+// random directions at a common speed, run event by event. Writes frames + 1 snapshots of
+// all positions, dt apart; the header records how many disks actually fit.
+HardDiskGas write_gas(
+    const SinaiBilliard& billiard, int count, double radius, double speed, int frames, double dt,
+    unsigned seed = 1);
+
+// Quantum mode: a Gaussian packet on the dh grid, MAX_POINTS frames 10 dt apart. RK4 takes
+// ten explicit steps per frame, split into bands of grid rows across `threads` workers;
+// SPLIT_OPERATOR takes unitary Strang steps with walls as a high potential, as few per
+// frame as the barrier allows (see SplitOperator). SPECTRAL expands the packet in the
+// lowest `states` eigenstates, the basis write_eigenstates caches for shift 0, and sets
+// each frame from the expansion directly. It suits smooth packets only, many cells wide
+// with k dh well under 1, whose energy sits low in the spectrum; the grid-scale default
+// packet needs most of the grid's states. There is no default count: it throws
+// runtime_error if states is not positive, if Weyl's law puts the packet's mean energy
+// above that many states (before the solve), or if they hold less than MIN_CAPTURED of
+// the packet's norm. CHEBYSHEV covers each frame in one Chebyshev expansion of the RK4
+// stencil's propagator, cut at `tolerance`.
+// The output does not depend on the thread count.
+const double MIN_CAPTURED = 0.99;
+enum class QuantumEngine { RK4, SPLIT_OPERATOR, SPECTRAL, CHEBYSHEV };
 vector<vector<float>> write_quantum(
     double dh, double dt, double sigma, double x0, double y0,
-    double k, double theta, const SinaiBilliard& billiard);
\ No newline at end of file
+    double k, double theta, const SinaiBilliard& billiard, int threads = 1,
+    QuantumEngine engine = QuantumEngine::RK4, int states = 0, double tolerance = 1e-12);
+
+// The `count` eigenstates of the table on the dh grid with energies nearest `shift`
+// (0 = the lowest). Writes eigen_data.bin: nx, ny, the state count and their energies,
+// then |state|^2 of each, scaled to a maximum of 1. The basis is cached in the data
+// directory and shared with the SPECTRAL quantum engine.
+Eigenbasis write_eigenstates(const SinaiBilliard& billiard, double dh, int count, double shift = 0);
\ No newline at end of file